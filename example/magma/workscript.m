@@ -32,14 +32,14 @@ end function;
 
 ComputeAndWriteToStdout:=procedure(fileName)
 	file:=Open(fileName,"r");
-	line:=Gets(file);
+	line:=NextComputation(file);
 	while not IsEof(line) do
 		primaryInput1,secondaryInput1,secondaryInput2:=ReadLine(line);
 		output:=Compute(primaryInput1,secondaryInput1,secondaryInput2);
 		WriteFields(primaryInput1,secondaryInput1,secondaryInput2,output);
-		line:=Gets(file);
+		line:=NextComputation(file);
 	end while;
 end procedure;
 
-ComputeAndWriteToStdout(dataFile);
+ProcessDataFiles(ComputeAndWriteToStdout);
 quit;
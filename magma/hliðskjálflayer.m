@@ -18,15 +18,18 @@
 
 This code should be loaded into the work script.
 
-The work script should read the computations to be done from dataFile and write the output of each computation to standard output using the function WriteComputation, or WriteFields.
+The work script should read the computations to be done from dataFile using the function NextComputation, and write the output of each computation to standard output using the function WriteComputation, or WriteFields.
+
+The computation itself should be performed by a procedure taking the name of a data file, which should be passed to ProcessDataFiles. This allows Hliðskjálf to run the work script in server mode, where a single Magma process is fed many data files through standard input.
 
 A function ReadComputation is also provided to read the output of WriteComputation (for usage without Hliðskjálf).
 
 */
 
-if assigned printVersion then print "undefined"; quit; end if;
+//the layer version is announced before the script version, which must be printed last
+if assigned printVersion then print "LAYER 4"; print "undefined"; quit; end if;
 
-if not assigned dataFile then error "variable dataFile should point to a valid data file"; end if;
+if not assigned dataFile and not assigned server then error "variable dataFile should point to a valid data file"; end if;
 if not assigned megabytes then error  "variable megabytes should indicate a memory limit in MB (or 0 for no limit)"; end if;
 
 MAX_LENGTH:=1000;
@@ -41,7 +44,9 @@ _JoinIntoOneLine:=function(lineWithNewlines)
 	return result;
 end function;
 
+/* Print a line of output. If framing is assigned, the line is printed as a record, i.e. a line "FRAME <length>" followed by the line itself, which is read by length and may contain newlines; otherwise, newlines are replaced by spaces, and lines longer than MAX_LENGTH are split into parts. */
 WriteComputation:=procedure(lineWithNewlines)
+	if assigned framing then printf "FRAME %o\n%o\n", #lineWithNewlines, lineWithNewlines; return; end if;
 	line:=_JoinIntoOneLine(lineWithNewlines);
 	if #line le MAX_LENGTH then print "LINE",line;
 	else
@@ -64,6 +69,27 @@ WriteFields:=procedure(field,...)
 	WriteComputation(line);
 end procedure;
 
+/* Read the next computation from a data file opened for reading, and signal to Hliðskjálf that the computation has started, so that if the process is killed Hliðskjálf knows which computation caused it. If dispatchIds is assigned, the computation is identified by the offset of the line in the data file, rather than the line itself. Returns an EOF object at the end of the file. */
+NextComputation:=function(file)
+	offset:=Tell(file);
+	line:=Gets(file);
+	if IsEof(line) then return line; end if;
+	if assigned dispatchIds then print "NEXT",offset; else print "START",line; end if;
+	return line;
+end function;
+
+/* Call process on the data files to be processed. Normally, this is just dataFile; in server mode (i.e. when server is assigned), the names of the data files are read from standard input, one per line, and "DONE" is printed after each of them has been processed. The procedure returns when standard input is closed. */
+ProcessDataFiles:=procedure(process)
+	if not assigned server then process(dataFile); return; end if;
+	input:=Open("/dev/stdin","r");
+	fileName:=Gets(input);
+	while not IsEof(fileName) do
+		process(fileName);
+		print "DONE";
+		fileName:=Gets(input);
+	end while;
+end procedure;
+
 _SplitLine:=function(line)
 	firstFiveChars:=Substring(line,1,5);
 	if #line gt 5 then 
@@ -99,5 +125,5 @@ end function;
 
 SetMemoryLimit(StringToInteger(megabytes)*1024*1024);
 SetQuitOnError(true);
-SetColumns(MAX_LENGTH+20);
+if assigned framing then SetColumns(0); else SetColumns(MAX_LENGTH+20); end if;	//records must not be broken into lines
 
@@ -0,0 +1,106 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef ADMISSION_POLICY_H
+#define ADMISSION_POLICY_H
+
+#include "stdincludes.h"
+#include "exception.h"
+#include <algorithm>
+
+//what MemoryManager knows when a thread asks for memory
+struct AdmissionState {
+	megabytes limit=0;	//total memory limit
+	megabytes allocated=0;	//memory allocated to the running threads
+	megabytes base_memory_limit=0;
+	megabytes lowest=0;	//the lowest memory limit with which some computation can be run
+	int suspended_threads=0;	//number of threads waiting for memory, including the one asking
+	vector<megabytes> running;	//memory allocated to each running thread
+	vector<pair<megabytes,int>> pending;	//number of computations to do, grouped by the highest memory limit they failed with; computations not attempted yet are listed with 0
+	vector<pair<megabytes,int>> slow;	//number of computations that ran out of time, to be retried with the same memory limit, grouped by memory limit
+};
+
+//decides how much memory to give to a thread that is about to start
+class AdmissionPolicy {
+public:
+	//return the megabytes that should be allocated, or nullopt if the thread should wait
+	virtual optional<megabytes> to_request(const AdmissionState& state) const=0;
+	virtual ~AdmissionPolicy()=default;
+};
+
+//start threads with twice the lowest effective limit, unless there is no room for another thread
+class HeuristicAdmissionPolicy : public AdmissionPolicy {
+public:
+	optional<megabytes> to_request(const AdmissionState& state) const override {
+		auto max_request=state.limit-state.allocated;
+		auto lowest=max(state.lowest,state.base_memory_limit);
+		if (max_request<=lowest) return nullopt;
+		if (state.suspended_threads==1) return max_request;
+		if (lowest>state.limit/3) return max_request;	//there is no room for another thread, so give all memory to this one
+		return min(lowest*2,max_request);
+	}
+};
+
+//Pack the pending computations into the available memory, largest first. A computation that failed with a limit L needs a thread with more than L megabytes, and preferably 2L; a computation that ran out of time with a limit L needs L megabytes, and a computation not attempted yet the base memory limit.
+//Each running thread is taken to serve one computation among those it can run, starting from the largest; the new thread is given the memory needed by the largest computation not served yet that fits in the memory available. Large computations are thus started as early as possible, while the memory they do not need goes to threads with the base memory limit
+class PackingAdmissionPolicy : public AdmissionPolicy {
+	struct Demand {
+		megabytes above;	//the thread must have more memory than this
+		megabytes preferred;
+		int computations;
+	};
+public:
+	optional<megabytes> to_request(const AdmissionState& state) const override {
+		auto max_request=state.limit-state.allocated;
+		vector<Demand> demands;
+		for (auto& p : state.pending)
+			if (p.first==0) demands.push_back({state.base_memory_limit-1,state.base_memory_limit,p.second});
+			else demands.push_back({p.first,max(p.first*2,state.base_memory_limit),p.second});
+		for (auto& p : state.slow)
+			demands.push_back({p.first-1,p.first,p.second});
+		std::sort(demands.begin(),demands.end(),[] (const Demand& a, const Demand& b) {return a.preferred>b.preferred;});
+		std::multiset<megabytes> running(state.running.begin(),state.running.end());
+		for (auto& demand : demands) {
+			int not_served=demand.computations;
+			for (auto it=running.upper_bound(demand.above);not_served>0 && it!=running.end();--not_served)
+				it=running.erase(it);
+			if (not_served>0 && max_request>demand.above) return min(demand.preferred,max_request);
+		}
+		return nullopt;
+	}
+};
+
+class UnknownAdmissionPolicyException : public Exception {
+	string name;
+public:
+	UnknownAdmissionPolicyException(const string& name) : name{name} {}
+	string what() const noexcept override {
+		return "unknown admission policy "+name;
+	}
+};
+
+//names of the policies that can be selected from the command line; the first is the default
+const vector<string> ADMISSION_POLICIES{"heuristic","packing"};
+
+unique_ptr<AdmissionPolicy> make_admission_policy(const string& name) {
+	if (name=="heuristic") return make_unique<HeuristicAdmissionPolicy>();
+	else if (name=="packing") return make_unique<PackingAdmissionPolicy>();
+	else throw UnknownAdmissionPolicyException{name};
+}
+
+#endif
@@ -0,0 +1,84 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef BATCH_SIZER_H
+#define BATCH_SIZER_H
+
+#include "stdincludes.h"
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+
+//time limits for a process running a batch; a zero duration means no limit
+struct BatchTimeouts {
+	static constexpr std::chrono::hours MAX_TIMEOUT{24*365*100};	//longer than any run, and short enough to be added to the time of a steady clock in nanoseconds
+	std::chrono::seconds progress;	//the process is killed if it runs this long without starting or completing a computation
+	std::chrono::seconds total;	//the process is killed if the batch takes longer than this
+	//the timeouts for a batch whose computations may each take the given time: a batch that keeps producing results is only stopped when it takes as long as its computations together, up to MAX_TIMEOUT
+	static BatchTimeouts for_batch(std::chrono::seconds per_computation, int computations) {
+		auto progress=min<std::chrono::seconds>(per_computation,MAX_TIMEOUT);
+		if (progress!=std::chrono::seconds::zero() && computations>MAX_TIMEOUT/progress) return {progress,MAX_TIMEOUT};
+		return {progress,progress*computations};
+	}
+};
+
+//chooses the number of computations to assign to a process, so that each batch takes about the given time. Measurements are kept separately for each memory limit, since computations that failed with a lower limit, and are retried with a higher one, tend to be slower.
+//The time per computation and the fraction of computations that fail are estimated from the recent batches; the batch size is reduced so that on average at most one computation fails in each batch, so that it shrinks towards 1 as the failure rate rises
+class BatchSizer {
+	static constexpr double DECAY=0.8;	//weight of the previous batches relative to the last one
+	struct Measurements {
+		double seconds=0;
+		double failed=0;
+		double attempted=0;
+	};
+	std::chrono::seconds target;
+	int initial_size;
+	map<megabytes,Measurements> measurements;
+	mutable mutex mtx;
+
+	//the measurements relative to memory_limit, or to the closest memory limit for which some batch has run
+	const Measurements* closest(megabytes memory_limit) const {
+		if (measurements.empty()) return nullptr;
+		auto above=measurements.lower_bound(memory_limit);
+		if (above==measurements.begin()) return &above->second;
+		auto below=std::prev(above);
+		if (above==measurements.end() || memory_limit-below->first<above->first-memory_limit) return &below->second;
+		return &above->second;
+	}
+public:
+	//initial_size is the batch size used until some batch has run
+	BatchSizer(std::chrono::seconds target, int initial_size) : target{target}, initial_size{initial_size} {}
+	//record a batch that ran for the given time with the given memory limit; failed is true if the process stopped before completing it
+	void record(megabytes memory_limit, int completed, bool failed, std::chrono::milliseconds wall_time) {
+		unique_lock<mutex> lock{mtx};
+		auto& m=measurements[memory_limit];
+		m.seconds=m.seconds*DECAY+wall_time.count()/1000.0;
+		m.failed=m.failed*DECAY+(failed? 1 : 0);
+		m.attempted=m.attempted*DECAY+completed+(failed? 1 : 0);
+	}
+	int size(megabytes memory_limit) const {
+		unique_lock<mutex> lock{mtx};
+		auto m=closest(memory_limit);
+		if (!m || !m->attempted) return initial_size;
+		double size=m->attempted*target.count()/max(m->seconds,0.001);	//the time of a failed computation counts as well
+		if (m->failed) size=min(size,m->attempted/m->failed);
+		return std::clamp<double>(std::floor(size),1,std::numeric_limits<int>::max());
+	}
+};
+
+#endif
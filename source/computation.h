@@ -20,25 +20,192 @@
 #define COMPUTATION_H
 #include "stdincludes.h"
 #include "csvschema.h"
+#include <unordered_map>
+#include <string_view>
+#include <boost/container_hash/hash.hpp>
+
+//text values of secondary inputs tend to be repeated across many computations, so each of them is stored only once and referred to by an index
+class StringPool {
+	deque<string> strings;
+	std::unordered_map<std::string_view,int> ids;
+	mutable shared_mutex mtx;
+	StringPool()=default;
+public:
+	int intern(const string& s) {
+		{
+			shared_lock<shared_mutex> lock{mtx};
+			auto it=ids.find(s);
+			if (it!=ids.end()) return it->second;
+		}
+		unique_lock<shared_mutex> lock{mtx};
+		auto it=ids.find(s);
+		if (it!=ids.end()) return it->second;
+		strings.push_back(s);
+		ids.emplace(strings.back(),strings.size()-1);
+		return strings.size()-1;
+	}
+	//references remain valid, since elements of a deque are not moved when new elements are inserted at the end
+	const string& operator[](int id) const {
+		shared_lock<shared_mutex> lock{mtx};
+		return strings[id];
+	}
+	static StringPool& singleton() {
+		static StringPool string_pool;
+		return string_pool;
+	}
+};
+
+//return the value of s as an integer if s is the canonical representation of an int, i.e. it coincides with std::to_string of its value
+optional<int> canonical_integer(const string& s) {
+	int first_digit=(!s.empty() && s[0]=='-')? 1 : 0;
+	int digits=s.size()-first_digit;
+	if (digits==0 || digits>std::numeric_limits<int>::digits10+1) return nullopt;
+	if (s[first_digit]=='0' && (digits>1 || first_digit)) return nullopt;
+	long long value=0;
+	for (int i=first_digit;i<s.size();++i) {
+		if (s[i]<'0' || s[i]>'9') return nullopt;
+		value=value*10+(s[i]-'0');
+	}
+	if (first_digit) value=-value;
+	if (value<std::numeric_limits<int>::min() || value>std::numeric_limits<int>::max()) return nullopt;
+	return static_cast<int>(value);
+}
+
+//a secondary input as stored in a Computation: an integer value, or an index into StringPool if text is true
+struct EncodedInput {
+	int value;
+	bool text;
+	static EncodedInput encode(const string& s) {
+		auto value=canonical_integer(s);
+		if (value) return {value.value(),false};
+		else return {StringPool::singleton().intern(s),true};
+	}
+};
 
 //we use the input fields defined by the schema to define the computation
+//secondary inputs are stored as integers when they represent integers (e.g. values taken from a range), and as indices into StringPool otherwise; a few of them fit inline, so that in the common case a Computation does not allocate memory.
+//Whether the i-th secondary input is text is recorded in text_inputs_ for the first INLINE_TEXT_FLAGS inputs, and in words stored after the values for the others
 class Computation {
 	friend std::size_t hash_value(const Computation&);
-	int primary_input_;
-	CSVLine secondary_inputs_;
+	static constexpr int INLINE_SECONDARY_INPUTS=4;
+	static constexpr int INLINE_TEXT_FLAGS=std::numeric_limits<std::uint32_t>::digits;
+	std::uint64_t hash_=0;
+	int primary_input_=0;
+	std::uint32_t text_inputs_=0;		//bit i is set if the i-th secondary input is an index into StringPool
+	std::uint16_t no_secondary_inputs_=0;
+	union {
+		int inline_[INLINE_SECONDARY_INPUTS];
+		int* heap_;
+	} secondary_inputs_;
+
+	//the number of ints needed to store the values and the text flags that do not fit in text_inputs_
+	static int storage_size(int no_secondary_inputs) {
+		return no_secondary_inputs>INLINE_TEXT_FLAGS? no_secondary_inputs+(no_secondary_inputs-1)/INLINE_TEXT_FLAGS : no_secondary_inputs;
+	}
+	int storage_size() const {return storage_size(no_secondary_inputs_);}
+	bool is_inline() const {return no_secondary_inputs_<=INLINE_SECONDARY_INPUTS;}
+	int* secondary_inputs() {return is_inline()? secondary_inputs_.inline_ : secondary_inputs_.heap_;}
+	const int* secondary_inputs() const {return is_inline()? secondary_inputs_.inline_ : secondary_inputs_.heap_;}
+	bool is_text(int i) const {
+		if (i<INLINE_TEXT_FLAGS) return text_inputs_ & (std::uint32_t{1}<<i);
+		i-=INLINE_TEXT_FLAGS;
+		return static_cast<std::uint32_t>(secondary_inputs()[no_secondary_inputs_+i/INLINE_TEXT_FLAGS]) & (std::uint32_t{1}<<(i%INLINE_TEXT_FLAGS));
+	}
+	void set_text(int i) {
+		if (i<INLINE_TEXT_FLAGS) text_inputs_|=std::uint32_t{1}<<i;
+		else {
+			i-=INLINE_TEXT_FLAGS;
+			auto& flags=secondary_inputs()[no_secondary_inputs_+i/INLINE_TEXT_FLAGS];
+			flags=static_cast<int>(static_cast<std::uint32_t>(flags) | (std::uint32_t{1}<<(i%INLINE_TEXT_FLAGS)));
+		}
+	}
+	void allocate(int no_secondary_inputs) {
+		if (no_secondary_inputs>std::numeric_limits<std::uint16_t>::max()) throw CSVException("too many secondary inputs",std::to_string(no_secondary_inputs));
+		no_secondary_inputs_=no_secondary_inputs;
+		if (!is_inline()) secondary_inputs_.heap_=new int[storage_size()]();
+	}
+	void deallocate() {
+		if (!is_inline()) delete[] secondary_inputs_.heap_;
+		no_secondary_inputs_=0;
+	}
+	void copy_from(const Computation& other) {
+		hash_=other.hash_;
+		primary_input_=other.primary_input_;
+		text_inputs_=other.text_inputs_;
+		allocate(other.no_secondary_inputs_);
+		std::copy(other.secondary_inputs(),other.secondary_inputs()+storage_size(),secondary_inputs());
+	}
+	void move_from(Computation& other) {
+		hash_=other.hash_;
+		primary_input_=other.primary_input_;
+		text_inputs_=other.text_inputs_;
+		no_secondary_inputs_=other.no_secondary_inputs_;
+		secondary_inputs_=other.secondary_inputs_;
+		other.no_secondary_inputs_=0;
+	}
+	template<typename Encoded> void init(int no_secondary_inputs, Encoded&& encoded) {
+		allocate(no_secondary_inputs);
+		auto values=this->secondary_inputs();
+		for (int i=0;i<no_secondary_inputs_;++i) {
+			EncodedInput input=encoded(i);
+			values[i]=input.value;
+			if (input.text) set_text(i);
+		}
+		std::size_t hash=primary_input_;
+		boost::hash_combine(hash,text_inputs_);
+		boost::hash_range(hash,values,values+storage_size());
+		hash_=hash;
+	}
 public:
 	Computation() = default;
-	Computation(int primary_input, const vector<string>& secondary_inputs) : primary_input_{primary_input}, secondary_inputs_{CSVLine::from_vector(secondary_inputs)} {}
-	Computation(int primary_input, const CSVLine& secondary_inputs) : primary_input_{primary_input}, secondary_inputs_{secondary_inputs} {}
+	Computation(int primary_input, const vector<string>& secondary_inputs) : primary_input_{primary_input} {
+		init(secondary_inputs.size(),[&secondary_inputs] (int i) {return EncodedInput::encode(secondary_inputs[i]);});
+	}
+	Computation(int primary_input, const CSVLine& secondary_inputs) : primary_input_{primary_input} {
+		init(secondary_inputs.size(),[&secondary_inputs] (int i) {return EncodedInput::encode(secondary_inputs[i]);});
+	}
+	//construct a computation whose i-th secondary input is encoded(i), without converting the inputs to text
+	template<typename Encoded> Computation(int primary_input, int no_secondary_inputs, Encoded&& encoded) : primary_input_{primary_input} {
+		init(no_secondary_inputs,std::forward<Encoded>(encoded));
+	}
+	Computation(const Computation& other) {copy_from(other);}
+	Computation(Computation&& other) noexcept {move_from(other);}
+	Computation& operator=(const Computation& other) {
+		if (this!=&other) {
+			deallocate();
+			copy_from(other);
+		}
+		return *this;
+	}
+	Computation& operator=(Computation&& other) noexcept {
+		if (this!=&other) {
+			deallocate();
+			move_from(other);
+		}
+		return *this;
+	}
+	~Computation() {deallocate();}
 
-	string to_string() const {return std::to_string(primary_input_)+";"+secondary_inputs_.to_string();}
+	string secondary_input(int i) const {
+		auto value=secondary_inputs()[i];
+		return is_text(i)? StringPool::singleton()[value] : std::to_string(value);
+	}
+	int no_secondary_inputs() const {return no_secondary_inputs_;}
+	string to_string() const {
+		string result=std::to_string(primary_input_)+";";
+		if (no_secondary_inputs_) result+=secondary_input(0);
+		for (int i=1;i<no_secondary_inputs_;++i) result+=";"+secondary_input(i);
+		return result;
+	}
 	bool operator==(const Computation& other) const {
-		return primary_input_==other.primary_input_ && secondary_inputs_==other.secondary_inputs_;
+		return hash_==other.hash_ && primary_input_==other.primary_input_ && text_inputs_==other.text_inputs_ && no_secondary_inputs_==other.no_secondary_inputs_ 
+			&& std::equal(secondary_inputs(),secondary_inputs()+storage_size(),other.secondary_inputs());
 	}
 	bool operator<(const Computation& other) const {
-		if (primary_input_<other.primary_input_) return true;
-		else if (primary_input_>other.primary_input_) return false;
-		else return secondary_inputs_<other.secondary_inputs_;
+		if (primary_input_!=other.primary_input_) return primary_input_<other.primary_input_;
+		else if (no_secondary_inputs_!=other.no_secondary_inputs_) return no_secondary_inputs_<other.no_secondary_inputs_;
+		else if (text_inputs_!=other.text_inputs_) return text_inputs_<other.text_inputs_;
+		else return std::lexicographical_compare(secondary_inputs(),secondary_inputs()+storage_size(),other.secondary_inputs(),other.secondary_inputs()+other.storage_size());
 	}
 	int primary_input() const {return primary_input_;}
 };
@@ -18,12 +18,21 @@
 #ifndef COMPUTATION_RUNNER_H
 #define COMPUTATION_RUNNER_H
 #include "synchronizedcomputations.h"
+#include "workoutputindex.h"
 #include <boost/process.hpp>
-#include <boost/asio/io_service.hpp>
+#include "processreactor.h"
+#include "layeroutput.h"
+#include "timerservice.h"
+#include "outputwriter.h"
+#include "memorysampler.h"
+#include "batchsizer.h"
 #include "parameters.h"
 #include <future>
+#include <algorithm>
+#include <csignal>
 
-constexpr int COMPUTATIONS_TO_STORE_IN_MEMORY=1024*1024;
+constexpr int COMPUTATIONS_TO_STORE_IN_MEMORY=192*1024*1024/BYTES_PER_COMPUTATION;	//keep up to 192 MB of unpacked and completed computations
+constexpr std::chrono::milliseconds RSS_SAMPLING_INTERVAL{200};
 
 
 class Processes {
@@ -40,8 +49,10 @@ public:
 	}	
 	void terminate() {		
 		unique_lock<mutex> lck{mtx};
-		for (auto child: processes)
-			child->terminate();
+		for (auto child: processes) {
+			std::error_code error;	//the process may have exited already
+			child->terminate(error);
+		}
 		processes.clear();
 	}	
 	int size() const {
@@ -49,102 +60,277 @@ public:
 	}		
 };
 
+//printed by the layer after each batch in server mode
+const string END_OF_BATCH="DONE";
+
+//a Magma process running the work script in server mode: the names of the data files are written to its standard input, and the process prints END_OF_BATCH after processing each of them
+class MagmaServer {
+	megabytes memory_limit_;
+	boost::process::opstream input;
+	boost::process::async_pipe output;
+	boost::asio::streambuf buffer;
+	boost::process::child child;
+public:
+	MagmaServer(const string& command_line, megabytes memory_limit, rlim_t address_space_limit, const string& error_file, ProcessReactor& reactor) : memory_limit_{memory_limit}, output{reactor.io_context()},
+		child{command_line, boost::process::std_in < input, boost::process::std_out > output, boost::process::std_err > boost::filesystem::path{error_file}, limit_address_space(address_space_limit)} {}
+	MagmaServer(const MagmaServer&)=delete;
+	~MagmaServer() {
+		std::error_code error;	//the process may have exited already
+		if (child.joinable()) child.terminate(error);	//a detached child has been reaped, and its pid may belong to another process
+	}
+	megabytes memory_limit() const {return memory_limit_;}
+	boost::process::child& process() {return child;}
+	//pass the output relative to data_filename to the parser, then call on_done with false if the process stopped before completing the batch
+	void run_batch(const string& data_filename, LayerOutputParser& parser, ProcessReactor& reactor, std::function<void(bool)> on_done) {
+		input<<data_filename<<endl;
+		reactor.read_lines(output,buffer,[&parser] (string&& line) {
+			if (line==END_OF_BATCH && !parser.record_length()) return false;
+			parser.add_line(std::move(line));
+			return true;
+		},[&parser] () {return parser.record_length();},std::move(on_done));
+	}
+};
+
+//a Magma process launched to run a single batch, with the pipe its output is read from
+struct BatchProcess {
+	boost::process::async_pipe output;
+	boost::asio::streambuf buffer;
+	boost::process::child child;
+	BatchProcess(const string& command_line, rlim_t address_space_limit, const string& error_file, ProcessReactor& reactor) : output{reactor.io_context()},
+		child{command_line, boost::process::std_in.close(), boost::process::std_out > output, boost::process::std_err > boost::filesystem::path{error_file}, limit_address_space(address_space_limit)} {}
+	BatchProcess(const BatchProcess&)=delete;
+};
+
 class MagmaRunner {
 	string magma_script;
 	string magma_path;	
 	Processes processes;
+	ProcessReactor reactor;
+	TimerService timers;
+	int layer_version_=1;
+	int rss_limit;	//percentage of the memory limit a process may use before being killed, or 0 if processes are not sampled
+	int address_space_limit;	//percentage of the memory limit to which the address space of each process is limited, or 0 for no limit
+	unique_ptr<MemorySampler> sampler;
+	mutex servers_mtx;
+	map<string,std::shared_ptr<MagmaServer>> servers;	//idle servers, indexed by process id
+	bool terminated=false;
+
+	//the data file and the standard error of the processes with a given id; being in memory, they do not outlive hliðskjálf
+	struct ProcessFiles {
+		MemoryFile data;
+		MemoryFile errors;
+	};
+	mutex process_files_mtx;
+	map<string,unique_ptr<ProcessFiles>> process_files;	//indexed by process id
 
-	void write_computations_to_do(const string& data_filename,const AssignedComputations& computations) {
+	ProcessFiles& files_of(const string& process_id) {
+		unique_lock<mutex> lock{process_files_mtx};
+		auto& files=process_files[process_id];
+		if (!files) files=make_unique<ProcessFiles>();
+		return *files;
+	}
+	//write the computations to a file in memory, or to a file in the huginn directory if that fails; return the path of the file
+	string write_computations_to_do(const string& process_id,const string& contents, const string& huginn) {
+		auto& memory_file=files_of(process_id).data;
+		if (memory_file.valid() && memory_file.write(contents)) return memory_file.path();
+		auto data_filename=huginn+"/"+process_id+".data";
 		ofstream file{data_filename,std::ofstream::trunc};
-		for (auto x: computations) file<<x.to_string()<<endl;
-		file.close();	
+		file<<contents;
+		return data_filename;
+	}
+	//the file receiving the standard error of the process for process_id: a file in memory, or a file in the huginn directory if that cannot be created
+	string error_file(const string& process_id, const string& huginn) {
+		auto& memory_file=files_of(process_id).errors;
+		return memory_file.valid()? memory_file.path() : huginn+"/"+process_id+".err";
+	}
+	//empty the error file for process_id before a new process is launched, and return its path
+	string new_error_file(const string& process_id, const string& huginn) {
+		auto& memory_file=files_of(process_id).errors;
+		if (memory_file.valid() && memory_file.write({})) return memory_file.path();
+		auto error_filename=huginn+"/"+process_id+".err";
+		ofstream{error_filename,std::ofstream::trunc};
+		return error_filename;
+	}
+	//remove the error file for process_id if it is stored in the huginn directory
+	void remove_error_file(const string& process_id, const string& huginn) {
+		if (files_of(process_id).errors.valid()) return;
+		boost::system::error_code error;
+		boost::filesystem::remove(huginn+"/"+process_id+".err",error);
 	}
 
-	enum class LineType {LINE,PART,OVER,INVALID};
-	pair<LineType, string> parse_line(const string& line) const {
-		auto first_five_chars=line.substr(0,5);
-		if (first_five_chars=="LINE "s) return {LineType::LINE,line.substr(5)};
-		else if (first_five_chars=="PART "s) return {LineType::PART,line.substr(5)};
-		else if (first_five_chars=="OVER"s) return {LineType::OVER,{}};
-		else return {LineType::INVALID,{}};	
+	rlim_t address_space_limit_in_bytes(megabytes memory_limit) const {
+		return rlim_t(memory_limit)*1024*1024*address_space_limit/100;
 	}
-	
-	void add_line(vector<string>& lines, const string& line, string& last_string) const {
-		auto type_and_string=parse_line(line);
-		switch (type_and_string.first) {
-			case LineType::LINE: 
-				lines.push_back(type_and_string.second); 
-				break;
-			case LineType::PART:
-				last_string+=type_and_string.second; 
-				break;
-			case LineType::OVER:
-				lines.push_back(last_string); 
-				last_string.clear();
-				break;
-			default:
-				break;
+	//the state of a process running a batch, shared with the timers that may kill it
+	struct Watch {
+		pid_t pid;
+		std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+		mutex reaping_mtx;
+		bool reaped=false;
+		bool timed_out=false;
+		optional<TimerService::TimerId> watchdog, deadline;
+		Watch(pid_t pid) : pid{pid} {}
+		//the process is killed with SIGKILL rather than child.terminate(), which would reap it and lose its resource usage; since a process that has terminated keeps its pid until it is reaped, the pid cannot have been reused when a timer kills it
+		void kill() {
+			unique_lock<mutex> lock{reaping_mtx};
+			if (!reaped && ::kill(pid,SIGKILL)==0) timed_out=true;
+		}
+	};
+	//start watching child while it runs a batch, killing it when one of the timeouts expires or, if it is sampled, when it exceeds its memory limit; the progress timeout is restarted whenever the parser sees a computation start or complete
+	std::shared_ptr<Watch> watch(boost::process::child& child,const BatchTimeouts& timeouts, megabytes memory_limit, LayerOutputParser& parser) {
+		auto watch=std::make_shared<Watch>(child.id());
+		processes.add(&child);
+		auto kill=[watch] () {watch->kill();};
+		if (timeouts.progress!=std::chrono::seconds::zero()) {
+			watch->watchdog=timers.schedule(timeouts.progress,kill);
+			parser.on_progress([this,id=watch->watchdog.value(),delay=timeouts.progress] () {timers.reschedule(id,delay);});
 		}
+		if (timeouts.total!=std::chrono::seconds::zero()) watch->deadline=timers.schedule(timeouts.total,kill);
+		if (sampler) sampler->add(watch->pid,long{memory_limit}*1024*rss_limit/100);
+		return watch;
 	}
-	static void terminate_after_timeout (boost::process::child& child, std::chrono::duration<int> timeout, future<void> canceled) {
-		if (canceled.wait_for(timeout)!=std::future_status::ready) {
-			child.terminate();
+	//stop watching child once it has run the batch, and return the resources it used; if it has terminated, it is reaped and its exit status is returned as well
+	ProcessUsage unwatch(Watch& watch, boost::process::child& child, bool terminated) {
+		ProcessUsage usage;
+		processes.remove(&child);	//before reaping, so that terminate_all cannot signal a reused pid
+		if (sampler) usage.memory_exceeded=sampler->remove(watch.pid);
+		if (terminated) {
+			unique_lock<mutex> lock{watch.reaping_mtx};
+			watch.reaped=reap_child(watch.pid,usage);
+			if (watch.reaped) child.detach();	//the child object would otherwise try to terminate it on destruction
 		}
+		//the timers hold a reference to watch, which is released when they are canceled
+		if (watch.watchdog) timers.cancel(watch.watchdog.value());
+		if (watch.deadline) timers.cancel(watch.deadline.value());
+		usage.timed_out=watch.timed_out;
+		usage.wall_time=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-watch.start);
+		return usage;
 	}
-	string launch_child(const string& command_line,std::chrono::duration<int> timeout) {
-		boost::asio::io_service ios;
-		std::future<std::string> data, error;
-		auto child=boost::process::child{command_line, boost::process::std_in.close(), boost::process::std_out > data, boost::process::std_err > error,ios};		
-		processes.add(&child);
-		promise<void> canceled;
-		if (timeout!=std::chrono::duration<int>::zero()) {
-			std::thread t{terminate_after_timeout,  std::ref(child), timeout, canceled.get_future()};
-			t.detach();
+	//run the process, passing each line of its standard output to the parser as soon as it is received, and call on_exit with its resource usage once it has terminated; if the process is terminated, only the lines printed before termination are received
+	void launch_child(const string& command_line,const BatchTimeouts& timeouts, megabytes memory_limit, const string& error_file, LayerOutputParser& parser, std::function<void(ProcessUsage&&)> on_exit) {
+		auto process=std::make_shared<BatchProcess>(command_line,address_space_limit_in_bytes(memory_limit),error_file,reactor);
+		auto watch=this->watch(process->child,timeouts,memory_limit,parser);
+		reactor.read_lines(process->output,process->buffer,[&parser] (string&& line) {
+			parser.add_line(std::move(line));
+			return true;
+		},[&parser] () {return parser.record_length();},[this,process,watch,on_exit=std::move(on_exit)] (bool) {
+			//the end of the output is taken as the sign that the process is exiting
+			reactor.wait_for_exit(watch->pid,[this,process,watch,on_exit] (bool terminated) {
+				on_exit(unwatch(*watch,process->child,terminated));
+			});
+		});
+	}
+	//return the idle server for process_id, launching a new one if there is none or its memory limit is different
+	std::shared_ptr<MagmaServer> take_server(const string& process_id, const Parameters& parameters, megabytes memory_limit) {
+		std::shared_ptr<MagmaServer> server;
+		{
+			unique_lock<mutex> lock{servers_mtx};
+			auto it=servers.find(process_id);
+			if (it!=servers.end()) {
+				server=std::move(it->second);
+				servers.erase(it);
+			}
 		}
-		ios.run();
-		canceled.set_value();
-		processes.remove(&child);
-		return data.get();
+		if (!server || server->memory_limit()!=memory_limit) 
+			server=std::make_shared<MagmaServer>(magma_path+" -b "+parameters.script_parameters.server_invocation(memory_limit),memory_limit,address_space_limit_in_bytes(memory_limit),
+				new_error_file(process_id,parameters.communication_parameters.huginn),reactor);
+		return server;
+	}
+	void return_server(const string& process_id, std::shared_ptr<MagmaServer> server) {
+		unique_lock<mutex> lock{servers_mtx};
+		if (!terminated) servers[process_id]=std::move(server);
 	}
-
-	//returns empty vector if timeout
- 	vector<string> launch_child_and_read_data(const string& command_line, std::chrono::duration<int> timeout) {
-		auto whole_result=launch_child(command_line,timeout);		
- 		vector<string> result;
- 		std::stringstream s{whole_result};
-		string line,last_string;
-		while (s && std::getline(s, line) && !line.empty())  			
-  			add_line(result,line,last_string);    		
-		return result;
- 	}
-
-
 public:
-	MagmaRunner(const string& magma_script) : magma_script{magma_script}, magma_path{::magma_path()} {}
+	MagmaRunner(const string& magma_script, int rss_limit, int address_space_limit) : magma_script{magma_script}, magma_path{::magma_path()}, rss_limit{rss_limit}, address_space_limit{address_space_limit} {
+		std::signal(SIGPIPE,SIG_IGN);	//writing to a server that has crashed should not terminate hliðskjálf
+		if (rss_limit) sampler=make_unique<MemorySampler>(RSS_SAMPLING_INTERVAL);
+	}
 
-	string script_version() const {
+	string script_version() {
 	  boost::process::ipstream is;
 	  cout<<magma_path+ " -b "+ScriptParameters{magma_script,".","printVersion:=true","."}.script_invocation("x",0)<<endl;
  		boost::process::system (magma_path+ " -b "+ScriptParameters{magma_script,".","printVersion:=true","."}.script_invocation("x",0),boost::process::std_out > is);
     std::string line;
     string script_version;
     while (std::getline(is, line) && !line.empty()) 
-	    script_version=line;
+			if (line.substr(0,6)=="LAYER "s) layer_version_=std::stoi(line.substr(6));
+			else script_version=line;
 		return script_version;
 	}
+	//version of the layer loaded by the work script, as announced when printing the script version; layers that do not announce it have version 1
+	int layer_version() const {return layer_version_;}
+	bool supports_server_mode() const {return layer_version_>=2;}
+	bool supports_framing() const {return layer_version_>=3;}
+	bool supports_dispatch_ids() const {return layer_version_>=4;}
 
-	 std::vector<std::string> invoke_magma_script(const string& process_id,const AssignedComputations& computations,const Parameters& parameters, megabytes memory_limit, std::chrono::duration<int> timeout) {						
-		auto data_filename=parameters.communication_parameters.huginn+"/"+process_id+".data";
-		write_computations_to_do(data_filename,computations);
-		return launch_child_and_read_data(magma_path+" -b "+parameters.script_parameters.script_invocation(data_filename, memory_limit),timeout);	
+	//data is written to the data file, and the process is handed over to the reactor. The output is passed to listener as it is produced; once the batch is over, on_completion is called on the reactor thread with the resources used by the process while running it. The listener must stay alive until then
+	void invoke_magma_script(const string& process_id,const string& data,const Parameters& parameters, megabytes memory_limit, const BatchTimeouts& timeouts, OutputListener& listener, std::function<void(ProcessUsage&&)> on_completion) {
+		auto data_filename=write_computations_to_do(process_id,data,parameters.communication_parameters.huginn);
+		auto huginn=parameters.communication_parameters.huginn;
+		auto parser=std::make_shared<LayerOutputParser>(listener);
+		if (!parameters.script_parameters.server_mode) {
+			auto error_filename=new_error_file(process_id,huginn);	//the standard error is only read to tell whether the process ran out of memory
+			launch_child(magma_path+" -b "+parameters.script_parameters.script_invocation(data_filename, memory_limit),timeouts,memory_limit,error_filename,*parser,
+				[this,process_id,huginn,error_filename,parser,on_completion=std::move(on_completion)] (ProcessUsage&& usage) {
+					usage.memory_error=parser->memory_error() || memory_error_in(error_filename);
+					remove_error_file(process_id,huginn);
+					on_completion(std::move(usage));
+				});
+			return;
+		}
+		auto server=take_server(process_id,parameters,memory_limit);
+		auto error_filename=error_file(process_id,huginn);
+		boost::system::error_code error;
+		std::streamoff errors_before=boost::filesystem::file_size(error_filename,error);
+		if (error) errors_before=0;
+		auto pid=server->process().id();
+		reset_peak_rss(pid);	//a server runs many batches, so its usage is measured as a difference
+		auto cpu_time_before=cpu_time_of(pid);
+		auto watch=this->watch(server->process(),timeouts,memory_limit,*parser);
+		auto finish=[this,process_id,server,error_filename,errors_before,pid,cpu_time_before,parser,on_completion=std::move(on_completion)] (ProcessUsage&& usage, bool completed) {
+			if (completed) {
+				usage.cpu_time=cpu_time_of(pid);
+				usage.max_rss_kb=peak_rss_kb(pid);
+				if (!usage.memory_exceeded && !usage.timed_out) return_server(process_id,server);	//the timer may have killed the server after it completed the batch
+			}
+			if (completed || usage.exit_status || usage.signal) usage.cpu_time-=cpu_time_before;	//otherwise the process could not be reaped and its usage is unknown
+			usage.memory_error=parser->memory_error() || memory_error_in(error_filename,errors_before);
+			on_completion(std::move(usage));
+		};
+		server->run_batch(data_filename,*parser,reactor,[this,server,watch,finish] (bool completed) {
+			if (completed) finish(unwatch(*watch,server->process(),false),true);
+			else reactor.wait_for_exit(watch->pid,[this,server,watch,finish] (bool terminated) {
+				finish(unwatch(*watch,server->process(),terminated),false);
+			});
+		});
+	}
+	//terminate the idle server for process_id, if any, and release the files in memory used by its processes
+	void stop_server(const string& process_id) {
+		{
+			unique_lock<mutex> lock{servers_mtx};
+			servers.erase(process_id);
+		}
+		unique_lock<mutex> lock{process_files_mtx};
+		process_files.erase(process_id);
 	}
 	void terminate_all() {
+		{
+			unique_lock<mutex> lock{servers_mtx};
+			terminated=true;
+			servers.clear();
+		}
 		processes.terminate();	
 	}
 	int running() const {return processes.size();}
 };
 
 
+struct BatchOutcome {
+	AssignedComputations not_completed;	//the computations of the batch that were not completed
+	optional<Computation> culprit;	//if not_completed is not empty, the computation that was running when the process stopped
+	ProcessUsage usage;	//resources used by the Magma process while running the batch
+};
+
 //TODO replace inheritance with a data member
 class ComputationRunner : public SynchronizedComputations {
 	static constexpr int NO_ID=-1;
@@ -152,7 +338,18 @@ class ComputationRunner : public SynchronizedComputations {
 	string script_version;
 	int last_process_id;
 	unique_ptr<MagmaRunner> magma_runner;
+	unique_ptr<WorkOutputIndex> work_output_index;
+	unique_ptr<CostModel> cost_model;
+	unique_ptr<BatchSizer> batch_sizer;	//set if batches are sized to take a given time
+	unique_ptr<OutputWriter> output_writer;	//declared after work_output_index, since it records the lines it writes in the index
 	CSVSchema schema;
+	thread unpacking_thread;
+	mutex unpacking_mtx;
+	condition_variable unpacking_cv;	//notified when computations have been unpacked, and when more computations may be needed
+	bool stop_unpacking=false;
+	UnpackingStatistics unpacking_statistics;
+	mutex batch_log_mtx;
+	ofstream batch_log;
 	
 	static void verify_files_exist(const Parameters& parameters) {
 		auto input_file=boost::filesystem::path(parameters.input_parameters.input_file);
@@ -168,25 +365,90 @@ class ComputationRunner : public SynchronizedComputations {
 		create_dir_if_needed(parameters.communication_parameters.huginn);		
 	}
 	
-//return the number of computation to assign to a process with a fixed memory_limit; this defaults to the parameter indicated in the command line, but it can be reduced if few computations remain to be done. If the only computations that remain to be done are the previously aborted computations, then the default parameter for the others. For the large thread, the default parameter is divided by the square of the number of threads
+//return the number of computation to assign to a process with a fixed memory_limit; this defaults to the parameter indicated in the command line, or to the size chosen by the batch sizer if a batch duration is given, but it can be reduced if few computations remain to be done. If the only computations that remain to be done are the previously aborted computations, then the default parameter for the others. For the large thread, the parameter indicated in the command line is divided by the square of the number of threads
 	int no_computations_to_assign(megabytes memory_limit) {
 		int nthreads=parameters.computation_parameters.nthreads;
 		int new_computations=no_computations();
-		int computations_per_process=(large_thread(memory_limit))? parameters.computation_parameters.computations_per_process/(nthreads*nthreads) : parameters.computation_parameters.computations_per_process;
+		int computations_per_process;
+		if (batch_sizer) computations_per_process=batch_sizer->size(memory_limit);
+		else if (large_thread(memory_limit)) computations_per_process=parameters.computation_parameters.computations_per_process/(nthreads*nthreads);
+		else computations_per_process=parameters.computation_parameters.computations_per_process;
 		if (new_computations) return min(computations_per_process,new_computations/parameters.computation_parameters.nthreads);
 		else return computations_per_process;
 	}
+	//append a line process id;memory limit (MB);timeout per computation (s);computations;completed computations;wall time (ms);CPU time (ms);peak resident set size (kB);exit status;signal;limit hit to the batch log; the exit status and the signal are left empty if unknown, e.g. because a server is still running, and the limit hit, memory or time, is only given if the batch failed
+	void log_batch(const string& process_id, megabytes memory_limit, std::chrono::seconds timeout, int computations, int completed, const ProcessUsage& usage, bool failed) {
+		unique_lock<mutex> lock{batch_log_mtx};
+		batch_log<<process_id<<";"<<memory_limit<<";"<<timeout.count()<<";"<<computations<<";"<<completed<<";"
+			<<usage.wall_time.count()<<";"<<usage.cpu_time.count()<<";"<<usage.max_rss_kb<<";";
+		if (usage.exit_status) batch_log<<usage.exit_status.value();
+		batch_log<<";";
+		if (usage.signal) batch_log<<usage.signal.value();
+		batch_log<<";";
+		if (failed) batch_log<<(usage.failure_cause()==FailureCause::TIME? "time" : "memory");
+		batch_log<<endl;
+	}
+	//the unpacking thread tries to keep at least this number of unpacked computations ready to be assigned
+	int low_water_mark() const {
+		return parameters.computation_parameters.computations_per_process*parameters.computation_parameters.nthreads;
+	}
+	//the number of unpacked computations that fit in memory next to the completed computations, but never less than the low water mark
+	int max_unpacked_computations(std::uintmax_t completed_memory) const {
+		auto completed=static_cast<int>(min<std::uintmax_t>(completed_memory/BYTES_PER_COMPUTATION,COMPUTATIONS_TO_STORE_IN_MEMORY));
+		return max(COMPUTATIONS_TO_STORE_IN_MEMORY-completed,low_water_mark());
+	}
+	void notify_unpacking_thread() {
+		{unique_lock<mutex> lock{unpacking_mtx};}	//acquiring the lock ensures the notification is not lost
+		unpacking_cv.notify_all();
+	}
+	void unpacking_loop(unique_ptr<ThreadUIHandle> thread_ui) {
+		auto db_view=create_db_view();
+		unique_lock<mutex> lock{unpacking_mtx};
+		while (true) {
+			unpacking_cv.wait(lock,[this] () {
+				return stop_unpacking || terminating() || (no_computations()<low_water_mark() && unpacking_pending());
+			});
+			if (stop_unpacking || terminating()) break;
+			lock.unlock();
+			auto start=std::chrono::steady_clock::now();
+			auto completed_memory=completed_computations().memory_used();
+			unpack_computations_and_remove_already_processed(low_water_mark(),max_unpacked_computations(completed_memory),db_view,*thread_ui);
+			auto elapsed=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start);
+			lock.lock();
+			++unpacking_statistics.batches;
+			unpacking_statistics.time_unpacking+=elapsed;
+			unpacking_statistics.completed=completed_computations().size();
+			unpacking_statistics.completed_memory=completed_memory/(1024*1024);
+			user_interface()->update_unpacking_statistics(unpacking_statistics);
+			unpacking_cv.notify_all();
+		}
+		unpacking_cv.notify_all();
+	}
+	//wait until some computations are unpacked, unless there is nothing left to unpack
+	void wait_for_unpacked_computations() {
+		unique_lock<mutex> lock{unpacking_mtx};
+		auto ready=[this] () {return no_computations()>0 || !unpacking_pending() || terminating();};
+		if (no_computations()<low_water_mark()) unpacking_cv.notify_all();
+		if (ready()) return;
+		auto start=std::chrono::steady_clock::now();
+		++unpacking_statistics.workers_waiting;
+		unpacking_cv.wait(lock,ready);
+		--unpacking_statistics.workers_waiting;
+		unpacking_statistics.time_waited_by_workers+=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start);
+	}
 protected:
-	int to_valhalla(AbortedComputations& computations) override {
+	//move to valhalla the computations that ran out of memory with the total memory limit, and those that ran out of time too many times; each is recorded with the memory limit, the timeout in seconds and the limit that was hit
+	int to_valhalla(AbortedComputations& computations, SlowComputations& slow_computations) override {
 		int memory_limit=parameters.computation_parameters.total_memory_limit;
 		auto removed=computations.remove_exceeding_memory_limit(memory_limit);
-		if (!removed.empty()) {
-			ofstream valhalla_file{parameters.communication_parameters.valhalla,std::ofstream::app};
-			for (auto& computation : removed) 
-				valhalla_file<<computation.to_string()<<";"<<memory_limit<<";"<<script_version<<endl;
-			return removed.size();
-		}
-		else return 0;
+		auto removed_slow=slow_computations.remove_exceeding_timeout_level(parameters.computation_parameters.timeout_escalations);
+		if (removed.empty() && removed_slow.empty()) return 0;
+		ofstream valhalla_file{parameters.communication_parameters.valhalla,std::ofstream::app};
+		for (auto& computation : removed) 
+			valhalla_file<<computation.to_string()<<";"<<memory_limit<<";"<<process_timeout(memory_limit).count()<<";memory;"<<script_version<<endl;
+		for (auto& slow : removed_slow) 
+			valhalla_file<<slow.computation.to_string()<<";"<<slow.memory_limit<<";"<<process_timeout(slow.memory_limit,slow.timeout_level-1).count()<<";time;"<<script_version<<endl;
+		return removed.size()+removed_slow.size();
 	}
 	optional<SimpleDatabaseView> create_db_view() const {
 		return !parameters.input_parameters.db.empty()? make_optional<SimpleDatabaseView>(parameters.input_parameters.db,schema.no_secondary_input_columns()) : nullopt;
@@ -197,14 +459,49 @@ public:
 		pt::ptree tree;
 		pt::read_info(parameters.input_parameters.schema,tree);
 		schema=CSVSchema{tree};		
-		magma_runner=make_unique<MagmaRunner>(parameters.script_parameters.script);
+		magma_runner=make_unique<MagmaRunner>(parameters.script_parameters.script,parameters.computation_parameters.rss_limit,parameters.computation_parameters.address_space_limit);
 		script_version=magma_runner->script_version();
+		if (this->parameters.script_parameters.server_mode && !magma_runner->supports_server_mode()) {
+			cout<<"Warning: the work script does not load a layer supporting server mode; a new process will be launched for each batch"<<endl;
+			this->parameters.script_parameters.server_mode=false;
+		}
+		this->parameters.script_parameters.framing=magma_runner->supports_framing();
+		this->parameters.script_parameters.dispatch_ids=magma_runner->supports_dispatch_ids();
 		verify_files_exist(parameters);
+		work_output_index=make_unique<WorkOutputIndex>(parameters.script_parameters.output_dir,parameters.communication_parameters.index,schema);
+		work_output_index->load(completed_computations());
+		if (!parameters.communication_parameters.costs.empty()) {
+			cost_model=make_unique<CostModel>(parameters.communication_parameters.costs,script_version,schema.no_secondary_input_columns());
+			use_cost_model(cost_model.get());
+		}
 		load_computations(parameters.input_parameters.input_file);
+		output_writer=make_unique<OutputWriter>(parameters.script_parameters.output_dir,parameters.script_parameters.work_output_extension,
+			static_cast<std::uintmax_t>(parameters.script_parameters.segment_size)*1024*1024,parameters.script_parameters.sync_output,
+			[this] (const string& segment, const vector<Computation>& computations) {
+				work_output_index->record(segment,computations);
+				mark_as_completed(computations);
+			});
 		last_process_id=SynchronizedComputations::last_used_id(parameters.script_parameters.output_dir);
+		if (parameters.computation_parameters.batch_duration!=std::chrono::seconds::zero())
+			batch_sizer=make_unique<BatchSizer>(parameters.computation_parameters.batch_duration,parameters.computation_parameters.computations_per_process);
+		batch_log.open(parameters.communication_parameters.batch_log,std::ofstream::app);
 	}
 	void load_computations(const string& file) {
-		SynchronizedComputations::load_computations(file,schema,COMPUTATIONS_TO_STORE_IN_MEMORY/2);
+		SynchronizedComputations::load_computations(file,schema);
+		notify_unpacking_thread();
+	}
+	//start the thread that unpacks computations in the background, ahead of the workers
+	void start_unpacking_thread(unique_ptr<ThreadUIHandle> thread_ui) {
+		stop_unpacking=false;
+		unpacking_thread=thread{&ComputationRunner::unpacking_loop,this,std::move(thread_ui)};
+	}
+	void stop_unpacking_thread() {
+		{
+			unique_lock<mutex> lock{unpacking_mtx};
+			stop_unpacking=true;
+		}
+		unpacking_cv.notify_all();
+		if (unpacking_thread.joinable()) unpacking_thread.join();
 	}
 	
 	static ComputationRunner& singleton() {
@@ -214,21 +511,21 @@ public:
 	
 	void print_computations(ThreadUIHandle& thread_ui) {
 		do {
-			int to_unpack=parameters.computation_parameters.total_memory_limit*1024*1024/128; //assume each Computation takes 128 bytes
-			unpack_computations_and_remove_already_processed(to_unpack,to_unpack, create_db_view(),parameters.script_parameters.output_dir, schema,thread_ui);
+			int to_unpack=parameters.computation_parameters.total_memory_limit*1024*1024/BYTES_PER_COMPUTATION;
+			unpack_computations_and_remove_already_processed(to_unpack,to_unpack, create_db_view(),thread_ui);
 			SynchronizedComputations::print_computations();
 		} while (!finished());
 	}
 	
-	void add_computations_to_do(AssignedComputations& assigned_computations, megabytes memory_limit,ThreadUIHandle& thread_ui) {
-			int min_threshold=parameters.computation_parameters.computations_per_process*parameters.computation_parameters.nthreads;
-			if (no_computations()<min_threshold) {
-				unpack_computations_and_remove_already_processed(parameters.computation_parameters.computations_per_process,COMPUTATIONS_TO_STORE_IN_MEMORY, create_db_view(), parameters.script_parameters.output_dir, schema,thread_ui);	
-			}
+	//return the time limit with which the assigned computations should be run
+	TimeLimit add_computations_to_do(AssignedComputations& assigned_computations, megabytes memory_limit,ThreadUIHandle& thread_ui) {
+			wait_for_unpacked_computations();
 			auto computations_per_process=no_computations_to_assign(memory_limit);
 			if (computations_per_process==0 && assigned_computations.empty()) computations_per_process=1;
-			SynchronizedComputations::add_computations_to_do(assigned_computations,computations_per_process,memory_limit);
-			thread_ui.computations_added(assigned_computations.size(),memory_limit, process_timeout(memory_limit));
+			auto time_limit=SynchronizedComputations::add_computations_to_do(assigned_computations,computations_per_process,memory_limit,parameters.computation_parameters.timeout_escalations);
+			if (no_computations()<low_water_mark()) notify_unpacking_thread();
+			thread_ui.computations_added(assigned_computations.size(),memory_limit, process_timeout(time_limit));
+			return time_limit;
 	}
 	
 	void tick() {	
@@ -245,27 +542,55 @@ public:
 	void terminate() {
 		SynchronizedComputations::terminate();
 		magma_runner->terminate_all();
+		notify_unpacking_thread();
+	}
+	//wait until all the output has been written; to be called after the workers have terminated
+	void close_output() {
+		output_writer.reset();
+	}
+	//called when a worker terminates, so that its Magma process does not outlive it
+	void release_process(const string& process_id) {
+		magma_runner->stop_server(process_id);
 	}
 	void set_no_computations(int ncomputations) {
 		if (ncomputations>0) parameters.computation_parameters.computations_per_process=ncomputations;
 	}
 
-	std::chrono::duration<int> process_timeout(megabytes memory_limit) const {
-		return (memory_limit*parameters.computation_parameters.base_timeout)/parameters.computation_parameters.base_memory_limit;
-	}
-	AssignedComputations compute(const string& process_id, AssignedComputations computations, megabytes memory_limit) const {
-		auto output_filename=parameters.script_parameters.output_dir+"/"+process_id+parameters.script_parameters.work_output_extension;		
-		if (terminating()) return AssignedComputations{};
-		auto data=	magma_runner->invoke_magma_script(process_id, computations,parameters,memory_limit,process_timeout(memory_limit));
-		ofstream output{output_filename,std::ofstream::app};		
-		for (auto& line : data) {
-			int size=computations.size();
-			erase(computations,CSVReader::extract_computation(line,schema));
-			if (computations.size()==size) std::cerr<<"cannot find computation "<<line<<endl;
-			output<<line<<endl;
+	//the time a single computation may take; it is proportional to the memory limit, and doubled at each timeout level up to BatchTimeouts::MAX_TIMEOUT
+	std::chrono::seconds process_timeout(megabytes memory_limit, int timeout_level=0) const {
+		std::chrono::seconds timeout{static_cast<long long>(memory_limit)*parameters.computation_parameters.base_timeout.count()/parameters.computation_parameters.base_memory_limit};
+		for (int i=0;i<timeout_level && timeout<BatchTimeouts::MAX_TIMEOUT;++i) timeout*=2;
+		return min<std::chrono::seconds>(timeout,BatchTimeouts::MAX_TIMEOUT);
+	}
+	std::chrono::seconds process_timeout(const TimeLimit& time_limit) const {
+		return process_timeout(time_limit.memory_limit,time_limit.level);
+	}
+	//run the computations in a Magma process, which is handed over to the reactor; on_completion is called on the reactor thread once the batch is over, or at once with an empty outcome if hliðskjálf is terminating
+	void compute(const string& process_id, AssignedComputations computations, megabytes memory_limit, const TimeLimit& time_limit, std::function<void(BatchOutcome&&)> on_completion) {
+		if (terminating()) {
+			on_completion({});
+			return;
 		}
-		return terminating()? AssignedComputations{} : computations;
-		//ui->completed_computations(data.size());
+		int no_computations=computations.size();
+		auto output=std::make_shared<BatchOutput>(schema,vector<Computation>{computations.begin(),computations.end()},*user_interface(),[this] (string&& line, const Computation& computation) {
+			output_writer->append(std::move(line),computation);	//the computation is marked as completed once it has been written
+		});
+		auto timeout=process_timeout(time_limit);
+		auto timeouts=BatchTimeouts::for_batch(timeout,no_computations);
+		magma_runner->invoke_magma_script(process_id,output->data_file_contents(),parameters,memory_limit,timeouts,*output,
+			[this,process_id,memory_limit,timeout,no_computations,output,on_completion=std::move(on_completion)] (ProcessUsage&& usage) {
+				if (terminating()) {
+					on_completion({});
+					return;
+				}
+				auto not_completed=output->not_completed();
+				auto culprit=output->culprit();
+				int completed=no_computations-not_completed.size();
+				log_batch(process_id,memory_limit,timeout,no_computations,completed,usage,culprit.has_value());
+				if (culprit && cost_model && usage.failure_cause()==FailureCause::MEMORY) cost_model->record_failure(culprit.value(),memory_limit,usage);
+				if (batch_sizer) batch_sizer->record(memory_limit,completed,culprit.has_value(),usage.wall_time);
+				on_completion({std::move(not_completed),std::move(culprit),usage});
+			});
 	}
 	bool large_thread(megabytes memory_limit) {
 		return memory_limit > 2*parameters.computation_parameters.base_memory_limit && memory_limit > 2*lowest_effective_memory_limit();
@@ -23,25 +23,25 @@
 
 class Field {
 public:
-	virtual vector<string> to_strings() const=0;	
+	virtual string value(int i) const=0;	//the i-th value, with 0<=i<no()
+	virtual EncodedInput encoded(int i) const=0;	//the i-th value, as stored in a Computation
 	virtual int no() const =0;
-	virtual list<unique_ptr<Field>> split(int parts) const=0;
 	virtual unique_ptr<Field> copy() const=0;
+	virtual ~Field()=default;
 };
 
 class TextField : public Field {
 	string text;
+	EncodedInput encoded_;
 public:
-	TextField(const string& s) : text{s} {}
-	vector<string> to_strings() const override {
-		return {text};
+	TextField(const string& s) : text{s}, encoded_{EncodedInput::encode(s)} {}
+	string value(int) const override {
+		return text;
 	}	
+	EncodedInput encoded(int) const override {
+		return encoded_;
+	}
 	int no() const override {return 1;}
-	list<unique_ptr<Field>> split(int parts) const override {
-		list<unique_ptr<Field>> result;
-		result.push_back(copy());
-		return result;
-	};
 	unique_ptr<Field> copy() const override {
 		return make_unique<TextField>(*this);
 	}
@@ -51,56 +51,24 @@ class RangeField : public Field {
 	int min,max;
 public:
 	RangeField(int min, int max) : min{min},max{max} {}
-	vector<string> to_strings() const override {
-		vector<string> result;
-		result.reserve(max-min+1);
-		for (int i = min; i<=max;++i)
-			result.push_back(std::to_string(i));
-		return result;
+	string value(int i) const override {
+		return std::to_string(min+i);
 	}	
-	int no() const override {return max-min+1;}
-	list<unique_ptr<Field>> split(int parts) const override {
-		int step=(max-min+1)/parts;
-		if (step==0) step=1;
-		int begin=min;
-		list<unique_ptr<Field>> result;
-		while (begin + 2*step<max) {
-			result.push_back(make_unique<RangeField>(begin,begin+step-1));
-			begin+=step;
-		}
-		result.push_back(make_unique<RangeField>(begin,max));
-		return result;
+	EncodedInput encoded(int i) const override {
+		return {min+i,false};
 	}
+	int no() const override {return max-min+1;}
 	unique_ptr<Field> copy() const override {
 		return make_unique<RangeField>(*this);
 	}
+	int first() const {return min;}
+	int last() const {return max;}
 };
 
 class ComputationTemplate {
+	friend class ComputationTemplateCursor;
 	int primary_input_;
 	vector<unique_ptr<Field>> secondary_inputs_;
-	list<Computation> computation_instances(vector<string> starting_with, vector<unique_ptr<Field>>::const_iterator to_assign) const {
-		list<Computation> result;
-		if (to_assign==secondary_inputs_.end()) return {Computation{primary_input_,starting_with}};	
-		starting_with.resize(starting_with.size()+1);
-		auto next=to_assign;
-		++next;
-		for (auto& field : (*to_assign)->	to_strings()) {
-			starting_with.back()=field;
-			result.splice(result.begin(),computation_instances(starting_with,next));
-		}
-		return result;
-	}	
-	int largest_field() const {
-		int largest=0;
-		int max_size=secondary_inputs_[0]->no();
-		for (int i=1;i<secondary_inputs_.size();++i)
-			if (secondary_inputs_[i]->no()>max_size) {
-				max_size=secondary_inputs_[i]->no();
-				largest=i;
-			}
-		return largest;
-	}
 public:
 	ComputationTemplate(int primary_input) : primary_input_{primary_input} {}
 	ComputationTemplate(ComputationTemplate&&)=default;
@@ -124,30 +92,63 @@ public:
 	void add_text(const string& field) {
 		secondary_inputs_.push_back(make_unique<TextField>(field));
 	}	
-	list<Computation> computation_instances() const {	
-		vector<string> starting_with;
-		starting_with.reserve(secondary_inputs_.size());
-		return computation_instances(starting_with,secondary_inputs_.begin());
-	}
 	int primary_input() const {return primary_input_;}
+	int no_secondary_inputs() const {return secondary_inputs_.size();}
+	//the value of the i-th secondary input, which should take a single value
+	string value(int i) const {
+		assert(secondary_inputs_[i]->no()==1);
+		return secondary_inputs_[i]->value(0);
+	}
+	//the indices of the secondary inputs taking more than one value; these are necessarily ranges
+	vector<int> multivalued_fields() const {
+		vector<int> result;
+		for (int i=0;i<secondary_inputs_.size();++i)
+			if (secondary_inputs_[i]->no()>1) result.push_back(i);
+		return result;
+	}
+	pair<int,int> range(int i) const {
+		auto& field=dynamic_cast<const RangeField&>(*secondary_inputs_[i]);
+		return {field.first(),field.last()};
+	}
+	//the template obtained by restricting the i-th secondary input, which should be a range, to min..max
+	ComputationTemplate with_range(int i, int min, int max) const {
+		ComputationTemplate result{*this};
+		result.secondary_inputs_[i]=make_unique<RangeField>(min,max);
+		return result;
+	}
+	//remove from this template the computations where the i-th secondary input, which should be a range taking more than one value, takes its first value, and return them as a template
+	ComputationTemplate split_first_value(int i) {
+		auto range=this->range(i);
+		auto result=with_range(i,range.first,range.first);
+		secondary_inputs_[i]=make_unique<RangeField>(range.first+1,range.second);
+		return result;
+	}
 	int no_computations() const {
 		int n=1;
 		for (auto& field : secondary_inputs_) n*=field->no();
 		return n;	
 	}
-	vector<ComputationTemplate> split(int max_size) const {
-		int parts=no_computations()/max_size+1;
-		if (parts == 1) return {*this};
-		vector<ComputationTemplate> result;
-		result.reserve(parts);
-		int i=largest_field();
-		auto split_fields=secondary_inputs_[i]->split(parts);
-		for (auto& split_field : 	split_fields) {
-			ComputationTemplate t{*this};
-			t.secondary_inputs_[i]=std::move(split_field);
-			result.push_back(std::move(t));
-		}
-		return result;
+};
+
+//generates the computations represented by a template one at a time, iterating through the values of the fields like an odometer
+class ComputationTemplateCursor {
+	ComputationTemplate computation_template;
+	vector<int> position;	//position[i] is the index of the current value of the i-th secondary input
+	int remaining;
+public:
+	ComputationTemplateCursor(ComputationTemplate&& computation_template) : computation_template{std::move(computation_template)}, 
+		position(this->computation_template.secondary_inputs_.size()), remaining{this->computation_template.no_computations()} {}
+	int primary_input() const {return computation_template.primary_input();}
+	int remaining_computations() const {return remaining;}
+	bool at_end() const {return remaining==0;}
+	Computation next() {
+		assert(!at_end());
+		auto& fields=computation_template.secondary_inputs_;
+		Computation computation{computation_template.primary_input(),static_cast<int>(fields.size()),[this,&fields] (int i) {return fields[i]->encoded(position[i]);}};
+		for (int i=static_cast<int>(fields.size())-1;i>=0 && ++position[i]==fields[i]->no();--i)
+			position[i]=0;
+		--remaining;
+		return computation;
 	}
 };
 
@@ -0,0 +1,91 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef COST_MODEL_H
+#define COST_MODEL_H
+
+#include "stdincludes.h"
+#include "computation.h"
+#include "hash.h"
+#include "csv.h"
+#include "processusage.h"
+#include <unordered_map>
+
+//records the computations that could not be completed within a given memory limit, so that later runs of the same work script can assign them directly to a process with a higher limit, rather than repeating the failures.
+//The costs file is only appended to; each failure is recorded as a line
+//	<computation>;<memory limit>;<peak resident set size (kB)>;<script version>
+//where the computation consists of the primary input and the secondary inputs, as in the valhalla file. Lines relative to a different script version are ignored, since a change in the work script may change the resources it needs.
+//A computation that failed is known to need more than its memory limit and more than the peak resident set size of the process, which may be larger if the work script does not enforce the limit
+class CostModel {
+	string script_version;
+	std::unordered_map<Computation,megabytes,boost::hash<Computation>> failed_at;	//the highest memory limit or peak resident set size at which each computation failed
+
+	static megabytes failure_limit(megabytes memory_limit, long max_rss_kb) {
+		return max(memory_limit,megabytes(max_rss_kb/1024));
+	}
+	mutable mutex mtx;
+	ofstream file;
+
+	void load(const string& filename, int no_secondary_inputs) {
+		ifstream s{filename};
+		string line;
+		while (std::getline(s,line)) {
+			CSVLine fields{line};
+			int memory_limit_field=max(no_secondary_inputs,1)+1;	//Computation::to_string() ends with a separator if there are no secondary inputs
+			if (fields.size()<memory_limit_field+3) continue;
+			string version=fields[memory_limit_field+2];
+			for (int i=memory_limit_field+3;i<fields.size();++i) version+=";"+fields[i];
+			if (version!=script_version) continue;
+			vector<string> secondary_inputs;
+			for (int i=1;i<=no_secondary_inputs;++i) secondary_inputs.push_back(fields[i]);
+			try {
+				Computation computation{std::stoi(fields[0]),secondary_inputs};
+				auto& limit=failed_at[computation];
+				limit=max(limit,failure_limit(std::stoi(fields[memory_limit_field]),std::stol(fields[memory_limit_field+1])));
+			}
+			catch (const std::exception&) {
+				std::cerr<<"invalid line in "<<filename<<": "<<line<<endl;
+			}
+		}
+	}
+public:
+	CostModel(const string& filename, const string& script_version, int no_secondary_inputs) : script_version{script_version} {
+		load(filename,no_secondary_inputs);
+		file.open(filename,std::ofstream::app);
+	}
+	CostModel(const CostModel&)=delete;
+	//the highest memory limit at which the computation is known to fail, or nullopt if no failure is known
+	optional<megabytes> failure_limit(const Computation& computation) const {
+		unique_lock<mutex> lock{mtx};
+		auto it=failed_at.find(computation);
+		if (it==failed_at.end()) return nullopt;
+		return it->second;
+	}
+	void record_failure(const Computation& computation, megabytes memory_limit, const ProcessUsage& usage) {
+		unique_lock<mutex> lock{mtx};
+		auto& limit=failed_at[computation];
+		limit=max(limit,failure_limit(memory_limit,usage.max_rss_kb));
+		file<<computation.to_string()<<";"<<memory_limit<<";"<<usage.max_rss_kb<<";"<<script_version<<endl;
+	}
+	int size() const {
+		unique_lock<mutex> lock{mtx};
+		return failed_at.size();
+	}
+};
+
+#endif
@@ -52,6 +52,30 @@ struct CSVReader {
 		return {primary_id,move(result)};
 	}
 	
+	//return true if the input columns of line coincide with the fields of data_line, i.e. the primary input followed by the secondary inputs; only the columns up to the last input column are split
+	static bool input_matches(std::string_view line, const CSVSchema& schema, std::string_view data_line) {
+		auto split=[] (std::string_view s, int max_fields) {
+			vector<std::string_view> fields;
+			std::size_t begin=0;
+			while (fields.size()<max_fields) {
+				auto end=s.find(';',begin);
+				fields.push_back(s.substr(begin,end==std::string_view::npos? end : end-begin));
+				if (end==std::string_view::npos) break;
+				begin=end+1;
+			}
+			return fields;
+		};
+		auto inputs=split(data_line,schema.no_secondary_input_columns()+2);
+		if (inputs.size()!=schema.no_secondary_input_columns()+1) return false;
+		int last_input_column=schema.primary_input_column;
+		for (auto input: schema.secondary_input_columns) last_input_column=max(last_input_column,input);
+		auto columns=split(line,last_input_column+1);
+		if (columns.size()<=last_input_column || columns[schema.primary_input_column]!=inputs[0]) return false;
+		for (int i=0;i<schema.secondary_input_columns.size();++i)
+			if (columns[schema.secondary_input_columns[i]]!=inputs[i+1]) return false;
+		return true;
+	}
+	
 	static ComputationTemplate extract_computation_template(const CSVLine& csvline, const CSVSchema& schema) {
 		ComputationTemplate result{stoi(csvline[schema.primary_input_column])};
 		for (auto input: schema.secondary_input_columns)
@@ -0,0 +1,263 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef FLAT_HASH_SET_H
+#define FLAT_HASH_SET_H
+
+#include "stdincludes.h"
+#include <cstring>
+#include <utility>
+
+//Open addressing hash set, in the style of SwissTable. Elements are stored in a single array of slots; a parallel array of control bytes records whether each slot is empty, deleted or full, and in the latter case holds 7 bits of the hash of the element.
+//Slots are divided into groups of 8, whose control bytes are compared in parallel by loading them into a 64-bit word; a lookup probes one group after another and stops at the first group containing an empty slot.
+//Erasing an element leaves a tombstone, unless the group has an empty slot, in which case no probe sequence can have gone past it. Tombstones are removed when the table is rehashed.
+//T must be default constructible; slots that do not contain an element hold a default-constructed T.
+template<typename T, typename Hash>
+class FlatHashSet {
+	static constexpr std::int8_t EMPTY=-128;
+	static constexpr std::int8_t DELETED=-2;
+	static constexpr int GROUP_SIZE=8;
+	static constexpr std::uint64_t LSBS=0x0101010101010101ull;
+	static constexpr std::uint64_t MSBS=0x8080808080808080ull;
+
+	unique_ptr<std::int8_t[]> control;
+	unique_ptr<T[]> slots;
+	std::size_t capacity_=0;	//zero or a power of two, not smaller than GROUP_SIZE
+	std::size_t size_=0;
+	std::size_t tombstones=0;
+	std::size_t take_from=0;	//slot where take() starts looking for elements
+	Hash hasher;
+
+	static std::size_t h1(std::size_t hash) {return hash>>7;}
+	static std::int8_t h2(std::size_t hash) {return hash & 0x7F;}
+
+	std::uint64_t group_at(std::size_t first_slot) const {
+		std::uint64_t group;
+		std::memcpy(&group,control.get()+first_slot,GROUP_SIZE);
+		return group;
+	}
+	//each function returns a word where the most significant bit of the i-th byte is set if the i-th byte of the group satisfies the condition; match may have false positives
+	static std::uint64_t match(std::uint64_t group, std::int8_t h2) {
+		auto x=group ^ (LSBS*static_cast<std::uint8_t>(h2));
+		return (x-LSBS) & ~x & MSBS;
+	}
+	static std::uint64_t match_empty(std::uint64_t group) {
+		return group & ~(group<<6) & MSBS;
+	}
+	static std::uint64_t match_empty_or_deleted(std::uint64_t group) {
+		return group & ~(group<<7) & MSBS;
+	}
+	static int first_byte(std::uint64_t mask) {
+		return __builtin_ctzll(mask)/8;
+	}
+	std::size_t groups() const {return capacity_/GROUP_SIZE;}
+	std::size_t max_load() const {return capacity_-capacity_/8;}
+
+	//call f on the first slot of each group in the probe sequence of hash, until f returns true
+	template<typename F> void probe(std::size_t hash, F&& f) const {
+		auto group_mask=groups()-1;
+		auto group=h1(hash) & group_mask;
+		for (std::size_t i=1;!f(group*GROUP_SIZE);++i)
+			group=(group+i) & group_mask;	//triangular numbers visit each group exactly once
+	}
+	optional<std::size_t> find_slot(const T& object, std::size_t hash) const {
+		if (!capacity_) return nullopt;
+		optional<std::size_t> result;
+		probe(hash,[this,&object,&result,hash] (std::size_t first_slot) {
+			auto group=group_at(first_slot);
+			for (auto candidates=match(group,h2(hash));candidates;candidates&=candidates-1) {
+				auto slot=first_slot+first_byte(candidates);
+				if (slots[slot]==object) {
+					result=slot;
+					return true;
+				}
+			}
+			return match_empty(group)!=0;
+		});
+		return result;
+	}
+	std::size_t find_free_slot(std::size_t hash) const {
+		std::size_t result;
+		probe(hash,[this,&result] (std::size_t first_slot) {
+			auto free=match_empty_or_deleted(group_at(first_slot));
+			if (free) result=first_slot+first_byte(free);
+			return free!=0;
+		});
+		return result;
+	}
+	void rehash(std::size_t new_capacity) {
+		auto old_control=std::move(control);
+		auto old_slots=std::move(slots);
+		auto old_capacity=capacity_;
+		capacity_=new_capacity;
+		control=make_unique<std::int8_t[]>(capacity_);
+		std::memset(control.get(),EMPTY,capacity_);
+		slots=make_unique<T[]>(capacity_);
+		tombstones=0;
+		take_from=0;
+		for (std::size_t i=0;i<old_capacity;++i)
+			if (old_control[i]>=0) {
+				auto hash=hasher(old_slots[i]);
+				auto slot=find_free_slot(hash);
+				control[slot]=h2(hash);
+				slots[slot]=std::move(old_slots[i]);
+			}
+	}
+	void reserve_one_more() {
+		if (size_+tombstones<max_load()) return;
+		else if (tombstones>size_/2) rehash(capacity_);
+		else rehash(max(capacity_*2,std::size_t{GROUP_SIZE}));
+	}
+	void erase_slot(std::size_t slot) {
+		auto first_slot=slot-slot%GROUP_SIZE;
+		if (match_empty(group_at(first_slot))) control[slot]=EMPTY;
+		else {
+			control[slot]=DELETED;
+			++tombstones;
+		}
+		slots[slot]=T{};
+		--size_;
+	}
+	std::size_t next_full_slot(std::size_t slot) const {
+		while (slot<capacity_ && control[slot]<0) ++slot;
+		return slot;
+	}
+	template<typename U> bool insert_with_hash(U&& object, std::size_t hash) {
+		if (find_slot(object,hash)) return false;
+		reserve_one_more();
+		auto slot=find_free_slot(hash);
+		if (control[slot]==DELETED) --tombstones;
+		control[slot]=h2(hash);
+		slots[slot]=std::forward<U>(object);
+		++size_;
+		return true;
+	}
+public:
+	class const_iterator {
+		friend class FlatHashSet;
+		const FlatHashSet* set;
+		std::size_t slot;
+		const_iterator(const FlatHashSet* set, std::size_t slot) : set{set}, slot{slot} {}
+	public:
+		using iterator_category=std::forward_iterator_tag;
+		using value_type=T;
+		using difference_type=std::ptrdiff_t;
+		using pointer=const T*;
+		using reference=const T&;
+		const T& operator*() const {return set->slots[slot];}
+		const T* operator->() const {return &set->slots[slot];}
+		const_iterator& operator++() {
+			slot=set->next_full_slot(slot+1);
+			return *this;
+		}
+		const_iterator operator++(int) {
+			auto result=*this;
+			++*this;
+			return result;
+		}
+		bool operator==(const const_iterator& other) const {return slot==other.slot;}
+		bool operator!=(const const_iterator& other) const {return slot!=other.slot;}
+	};
+	using iterator=const_iterator;
+
+	FlatHashSet()=default;
+	FlatHashSet(FlatHashSet&& other) noexcept {*this=std::move(other);}
+	FlatHashSet(const FlatHashSet& other) {*this=other;}
+	FlatHashSet& operator=(FlatHashSet&& other) noexcept {
+		control=std::move(other.control);
+		slots=std::move(other.slots);
+		capacity_=std::exchange(other.capacity_,0);
+		size_=std::exchange(other.size_,0);
+		tombstones=std::exchange(other.tombstones,0);
+		take_from=std::exchange(other.take_from,0);
+		return *this;
+	}
+	FlatHashSet& operator=(const FlatHashSet& other) {
+		if (this==&other) return *this;
+		capacity_=other.capacity_;
+		size_=other.size_;
+		tombstones=other.tombstones;
+		take_from=other.take_from;
+		control=capacity_? make_unique<std::int8_t[]>(capacity_) : nullptr;
+		slots=capacity_? make_unique<T[]>(capacity_) : nullptr;
+		if (capacity_) {
+			std::memcpy(control.get(),other.control.get(),capacity_);
+			std::copy(other.slots.get(),other.slots.get()+capacity_,slots.get());
+		}
+		return *this;
+	}
+
+	bool insert(const T& object) {return insert_with_hash(object,hasher(object));}
+	bool insert(T&& object) {
+		auto hash=hasher(object);
+		return insert_with_hash(std::move(object),hash);
+	}
+	template<typename Iterator> void insert(Iterator begin, Iterator end) {
+		while (begin!=end) insert(*begin++);
+	}
+	std::size_t erase(const T& object) {
+		auto slot=find_slot(object,hasher(object));
+		if (!slot) return 0;
+		erase_slot(slot.value());
+		return 1;
+	}
+	const_iterator erase(const_iterator position) {
+		erase_slot(position.slot);
+		return const_iterator{this,next_full_slot(position.slot+1)};
+	}
+	std::size_t count(const T& object) const {
+		return find_slot(object,hasher(object))? 1 : 0;
+	}
+	//move at most n elements into destination, removing them from this set; return the number of elements moved
+	template<typename Container> int take(int n, Container& destination) {
+		int taken=0;
+		auto start=take_from;
+		for (std::size_t i=0;i<capacity_ && taken<n && size_;++i) {
+			auto slot=(start+i) & (capacity_-1);
+			if (control[slot]<0) continue;
+			destination.insert(std::move(slots[slot]));
+			erase_slot(slot);
+			++taken;
+			take_from=slot+1;
+		}
+		if (!size_) clear();
+		return taken;
+	}
+	void reserve(std::size_t n) {
+		auto new_capacity=std::size_t{GROUP_SIZE};
+		while (new_capacity-new_capacity/8<=n) new_capacity*=2;
+		if (new_capacity>capacity_) rehash(new_capacity);
+	}
+	void clear() {
+		control.reset();
+		slots.reset();
+		capacity_=size_=tombstones=take_from=0;
+	}
+	const_iterator begin() const {return const_iterator{this,next_full_slot(0)};}
+	const_iterator end() const {return const_iterator{this,capacity_};}
+	std::size_t size() const {return size_;}
+	bool empty() const {return size_==0;}
+};
+
+template<typename T,typename Hash>
+void erase(FlatHashSet<T,Hash>& container, const T& object)
+{
+	container.erase(object);
+}
+
+#endif
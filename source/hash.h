@@ -10,10 +10,7 @@ std::size_t hash_value(const CSVLine& line) {
 };
 
 std::size_t hash_value(const Computation& computation) {
-	static boost::hash<int> hasher;
-	auto hash=hasher(computation.primary_input_);
-	boost::hash_combine(hash,computation.secondary_inputs_);
-	return hash;
+	return computation.hash_;
 };
 
 #endif
@@ -45,8 +45,8 @@ void launch_threads(const Parameters& parameters, UserInterface* ui) {
 	try {
 		promise<void> terminate_signal;	
 		thread ui_thread=create_ui_thread(terminate_signal.get_future());
-		WorkerThreads worker_threads{parameters,ui};
-		worker_threads.join();
+		Scheduler scheduler{parameters,ui};
+		scheduler.join();
 		terminate_signal.set_value();
 		ui_thread.join();
 	}
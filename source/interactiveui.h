@@ -27,7 +27,7 @@ class InteractiveUserInterface : public UserInterface {
 	friend class ThreadInteractiveUIHandle;
 	Screen screen;
 	VerticalLayout layout;
-	WindowHandle status_window, msg_window, bad_window, memory_window, input_window;
+	WindowHandle status_window, unpacking_window, msg_window, bad_window, memory_window, input_window;
 	Controller* controller;
 	void print_status(int packed_computations, int unpacked_computations, int bad, int abandoned) {
 		auto overall_computations=packed_computations+unpacked_computations+bad;
@@ -41,6 +41,7 @@ class InteractiveUserInterface : public UserInterface {
 public:
 	InteractiveUserInterface() : layout{screen} {
  		status_window=layout.create_window(1,WindowType::CHILD);
+		unpacking_window=layout.create_window(1,WindowType::CHILD);
  		msg_window=layout.create_window(1,WindowType::CHILD);
 		auto bad_and_memory_windows=layout.create_windows(1,WindowType::CHILD,WindowType::CHILD);
 		bad_window=bad_and_memory_windows[0];
@@ -107,7 +108,14 @@ public:
 	
 	void print_computation(const Computation& computation) override {	}
 	void display_memory_limit(MemoryUse memory) override {
-		memory_window<<clear<<"Total limit: "<<memory.limit<<"MB ("<<memory.allocated<<" allocated, "<<memory.free<<" free)\tLower limit per thread: "<<memory.base_memory_limit<<"MB"<<release;
+		memory_window<<clear<<"Total limit: "<<memory.limit<<"MB ("<<memory.allocated<<" allocated, "<<memory.free<<" free)\tLower limit per thread: "<<memory.base_memory_limit<<"MB\tPeak use: "<<memory.peak<<"MB"<<release;
+	}
+	void discarded_output(const string& line, const string& reason) override {
+		msg_window<<clear<<"discarding output ("<<reason<<"): "<<line<<release;
+	}
+	void update_unpacking_statistics(const UnpackingStatistics& statistics) override {
+		unpacking_window<<clear<<"Unpacking batches: "<<statistics.batches<<"\tTime unpacking: "<<statistics.time_unpacking.count()<<"ms\tTime waited by workers: "<<statistics.time_waited_by_workers.count()<<"ms\tWorkers waiting: "<<statistics.workers_waiting
+			<<"\tCompleted: "<<statistics.completed<<" ("<<statistics.completed_memory<<"MB)"<<release;
 	}
 	unique_ptr<ThreadUIHandle> make_thread_handle(int thread) override;
 };
@@ -130,11 +138,11 @@ class ThreadInteractiveUIHandle : public ThreadUIHandle {
 public:
 	ThreadInteractiveUIHandle(const array<WindowHandle,2>& windows,int thread) : status_window{windows[0]}, msg_window{windows[1]}, thread{thread} {	
 	}
- 	void computations_added(int assigned_computations, megabytes memory, std::chrono::duration<int> timeout) override {
+ 	void computations_added(int assigned_computations, megabytes memory, std::chrono::seconds timeout) override {
 		print_thread_id(memory);
 		if (assigned_computations) {
 			status_window<<"working on "<<assigned_computations<<" computations";
-			if (timeout!=std::chrono::duration<int>::zero()) status_window<<", timeout "<<std::chrono::duration_cast<std::chrono::seconds>(timeout).count()<<"s";
+			if (timeout!=std::chrono::seconds::zero()) status_window<<", timeout "<<timeout.count()<<"s";
 			status_window<<release;
 		}
 		else status_window<<release; 
@@ -147,15 +155,15 @@ public:
 		print_thread_id(memory);
 		status_window<<"(paused)"<<release;
 	}
-	void bad_computation(const Computation& computation, megabytes memory_limit, std::chrono::duration<int> timeout) override {
+	void bad_computation(const Computation& computation, megabytes memory_limit, std::chrono::seconds timeout, const ProcessUsage& usage) override {
 		print_msg_time();
 		msg_window<<"could not complete "<<computation.to_string()<<" with "<<memory_limit<<" MB of memory";
-		if (timeout!=std::chrono::duration<int>::zero()) msg_window<<" in less than "<<std::chrono::duration_cast<std::chrono::seconds>(timeout).count()<<"s";
-		msg_window<<release;
+		if (timeout!=std::chrono::seconds::zero()) msg_window<<" in less than "<<timeout.count()<<"s";
+		msg_window<<" ("<<usage.to_string()<<")"<<release;
 	}
-	void finished_computations(int no_computations, megabytes memory) override {
+	void finished_computations(int no_computations, megabytes memory, const ProcessUsage& usage) override {
 		print_msg_time();
-		msg_window<<"completed "<<no_computations<<" computations with "<<memory<<" MB of memory"<<release;	
+		msg_window<<"completed "<<no_computations<<" computations with "<<memory<<" MB of memory ("<<usage.to_string()<<")"<<release;	
 	}
 	void thread_terminated() override {
 		print_thread_id(0);
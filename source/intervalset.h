@@ -0,0 +1,70 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef INTERVAL_SET_H
+#define INTERVAL_SET_H
+
+#include "stdincludes.h"
+
+//a set of integers, stored as a union of disjoint closed intervals, none of which are adjacent.
+//Bounds are only incremented after comparing them with a larger value and decremented after comparing them with a smaller one, so that no arithmetic overflows at the ends of the range of int
+class IntervalSet {
+	map<int,int> intervals;	//maps the minimum of each interval to its maximum
+public:
+	void insert(int x) {
+		auto next=intervals.upper_bound(x);
+		if (next!=intervals.begin()) {
+			auto previous=std::prev(next);
+			if (previous->second>=x) return;
+			else if (previous->second+1==x) {
+				previous->second=x;
+				if (next!=intervals.end() && next->first-1==x) {
+					previous->second=next->second;
+					intervals.erase(next);
+				}
+				return;
+			}
+		}
+		if (next!=intervals.end() && next->first-1==x) {
+			intervals.emplace_hint(next,x,next->second);
+			intervals.erase(next);
+		}
+		else intervals.emplace_hint(next,x,x);
+	}
+	//return the subintervals of min..max made of elements not in the set
+	vector<pair<int,int>> complement(int min, int max) const {
+		vector<pair<int,int>> result;
+		auto i=intervals.upper_bound(min);
+		if (i!=intervals.begin() && std::prev(i)->second>=min) {
+			if (std::prev(i)->second>=max) return result;
+			min=std::prev(i)->second+1;
+		}
+		for (;i!=intervals.end() && i->first<=max;++i) {
+			if (i->first>min) result.emplace_back(min,i->first-1);
+			if (i->second>=max) return result;
+			min=i->second+1;
+		}
+		result.emplace_back(min,max);
+		return result;
+	}
+	int no_intervals() const {return intervals.size();}
+	auto begin() const {return intervals.begin();}
+	auto end() const {return intervals.end();}
+};
+
+#endif
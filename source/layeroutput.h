@@ -0,0 +1,189 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LAYER_OUTPUT_H
+#define LAYER_OUTPUT_H
+
+#include "stdincludes.h"
+#include "synchronizedcomputations.h"
+#include "processusage.h"
+#include <functional>
+#include <algorithm>
+
+//receives the output of a work script as it is produced
+class OutputListener {
+public:
+	virtual void started(const string& data_line)=0;	//the work script signalled that it started the computation in data_line
+	virtual void started_at(std::size_t offset)=0;	//the work script signalled that it started the computation at the given offset in the data file
+	virtual void completed(string&& line)=0;	//the work script printed the output of a computation
+	virtual void discarded(const string& record)=0;	//the work script printed a record whose length does not match the announced one
+	virtual ~OutputListener()=default;
+};
+
+//parses the output of a work script one line at a time, reassembling lines split by WriteComputation.
+//Layers from version 3 on write each computation as a record, i.e. a line FRAME <length> followed by the given number of bytes and a newline; the reader should then read the record by length, as indicated by record_length(). Newlines in a record are replaced by spaces, so that it can be stored as a line of the work output; a record whose length does not match, e.g. because the process was killed while printing it, is discarded
+class LayerOutputParser {
+	enum class LineType {LINE,PART,OVER,START,NEXT,FRAME,INVALID};
+	OutputListener& listener;
+	string last_string;
+	optional<std::size_t> frame_length;	//set if the next line is the contents of a record
+	bool ended=false;
+	bool memory_error_=false;
+	std::function<void()> progress_;	//called when a computation is started or completed
+
+	static bool starts_with(const string& line, const char* prefix) {
+		return line.compare(0,std::char_traits<char>::length(prefix),prefix)==0;
+	}
+	pair<LineType, string> parse_line(const string& line) const {
+		if (starts_with(line,"LINE ")) return {LineType::LINE,line.substr(5)};
+		else if (starts_with(line,"PART ")) return {LineType::PART,line.substr(5)};
+		else if (line=="OVER") return {LineType::OVER,{}};
+		else if (starts_with(line,"START ")) return {LineType::START,line.substr(6)};
+		else if (starts_with(line,"FRAME ")) return {LineType::FRAME,line.substr(6)};
+		else if (starts_with(line,"NEXT ")) return {LineType::NEXT,line.substr(5)};
+		else return {LineType::INVALID,{}};
+	}
+public:
+	LayerOutputParser(OutputListener& listener) : listener{listener} {}
+	//true if Magma printed an out of memory error among the lines that are not part of the protocol
+	bool memory_error() const {return memory_error_;}
+	void on_progress(std::function<void()> progress) {progress_=std::move(progress);}
+	//the length of the record expected as the next item, or nullopt if a line is expected
+	optional<std::size_t> record_length() const {return frame_length;}
+	//an empty line marks the end of the output
+	void add_line(string&& line) {
+		if (frame_length) {
+			if (line.size()==frame_length.value()) {
+				std::replace(line.begin(),line.end(),'\n',' ');
+				listener.completed(std::move(line));
+				if (progress_) progress_();
+			}
+			else listener.discarded(line);
+			frame_length.reset();
+			return;
+		}
+		if (line.empty()) ended=true;
+		if (ended) return;
+		auto type_and_string=parse_line(line);
+		if (progress_ && type_and_string.first!=LineType::PART && type_and_string.first!=LineType::FRAME && type_and_string.first!=LineType::INVALID) progress_();
+		switch (type_and_string.first) {
+			case LineType::LINE:
+				listener.completed(std::move(type_and_string.second));
+				break;
+			case LineType::PART:
+				last_string+=type_and_string.second;
+				break;
+			case LineType::OVER:
+				listener.completed(std::move(last_string));
+				last_string.clear();
+				break;
+			case LineType::FRAME:
+				try {
+					frame_length=std::stoul(type_and_string.second);
+				}
+				catch (const std::exception&) {}
+				break;
+			case LineType::NEXT:
+				try {
+					listener.started_at(std::stoul(type_and_string.second));
+				}
+				catch (const std::exception&) {}
+				break;
+			case LineType::START:
+				listener.started(type_and_string.second);
+				break;
+			default:
+				if (is_memory_error(line)) memory_error_=true;
+				break;
+		}
+	}
+};
+
+//receives the output of a batch, passing each line to on_output together with its computation as soon as the line is received; output that cannot be used is reported to the user interface.
+//Computations are identified by their index in the batch. The work script signals which computation it has started by the offset of the corresponding line in the data file, and the output that follows is matched to that computation by comparing the input columns; output that does not match is parsed and looked up in the batch
+class BatchOutput : public OutputListener {
+	const CSVSchema& schema;
+	vector<Computation> batch;
+	vector<string> data_lines;
+	string data;	//the contents of the data file
+	std::unordered_map<std::size_t,int> index_by_offset;
+	vector<bool> completed_;
+	optional<int> running;	//index of the last computation signalled as started
+	UserInterface& ui;
+	std::function<void(string&&,const Computation&)> on_output;
+
+	optional<int> find(const Computation& computation) const {
+		for (int i=0;i<batch.size();++i)
+			if (!completed_[i] && batch[i]==computation) return i;
+		return nullopt;
+	}
+	optional<int> index_of_output(const string& line) const {
+		if (running && !completed_[running.value()] && CSVReader::input_matches(line,schema,data_lines[running.value()])) return running;
+		return find(CSVReader::extract_computation(line,schema));
+	}
+public:
+	BatchOutput(const CSVSchema& schema, vector<Computation>&& computations, UserInterface& ui, std::function<void(string&&,const Computation&)> on_output) :
+		schema{schema}, batch{std::move(computations)}, completed_(batch.size()), ui{ui}, on_output{std::move(on_output)} {
+		data_lines.reserve(batch.size());
+		for (int i=0;i<batch.size();++i) {
+			index_by_offset.emplace(data.size(),i);
+			data_lines.push_back(batch[i].to_string());
+			(data+=data_lines.back())+='\n';
+		}
+	}
+	const string& data_file_contents() const {return data;}
+	void started(const string& data_line) override {
+		int next=running? running.value()+1 : 0;
+		if (next<batch.size() && data_lines[next]==data_line) running=next;
+		else {
+			auto it=std::find(data_lines.begin(),data_lines.end(),data_line);
+			if (it!=data_lines.end()) running=it-data_lines.begin();
+		}
+	}
+	void started_at(std::size_t offset) override {
+		auto it=index_by_offset.find(offset);
+		if (it!=index_by_offset.end()) running=it->second;
+	}
+	void completed(string&& line) override {
+		auto index=index_of_output(line);
+		if (!index) {
+			ui.discarded_output(line,"no computation of the batch matches it");
+			return;
+		}
+		completed_[index.value()]=true;
+		on_output(std::move(line),batch[index.value()]);
+	}
+	void discarded(const string& record) override {
+		ui.discarded_output(record,"truncated record");
+	}
+	AssignedComputations not_completed() const {
+		AssignedComputations result;
+		for (int i=0;i<batch.size();++i)
+			if (!completed_[i]) result.insert(batch[i]);
+		return result;
+	}
+	//return the computation that was running when the process stopped: the last one signalled as started, or the first one in the batch that was not completed if the work script does not signal started computations
+	optional<Computation> culprit() const {
+		if (running && !completed_[running.value()]) return batch[running.value()];
+		for (int i=0;i<batch.size();++i)
+			if (!completed_[i]) return batch[i];
+		return nullopt;
+	}
+};
+
+#endif
@@ -1,86 +1,92 @@
 #ifndef MEMORY_MANAGER_H
 #define MEMORY_MANAGER_H
-#include <condition_variable>
 #include "stdincludes.h"
 #include "computationrunner.h"
+#include "admissionpolicy.h"
 
 
 class MemoryManager {
 	mutex suspension_mtx;		//mutex used to lock access to all the data in this class
 	megabytes allocated=0,limit,base_memory_limit;
-	std::condition_variable suspension;
+	megabytes peak=0;	//largest resident set size measured for a batch
+	std::function<void()> memory_available;	//called when more memory may be available to the threads waiting for it
 	int suspended_threads=0;
+	map<megabytes,int> running;	//number of running threads with each memory limit
+	unique_ptr<AdmissionPolicy> policy=make_unique<HeuristicAdmissionPolicy>();
 	
 	bool finished() const {
 		return ComputationRunner::singleton().finished();
 	}
 	//return the megabytes that should be allocated or nullopt if not enough memory is available to start another process
 	optional<megabytes> to_request() const {
-		auto max_request=limit-allocated;
-		auto lowest=max(ComputationRunner::singleton().lowest_effective_memory_limit(),base_memory_limit);
-		if (max_request<=lowest) return nullopt;
-		if (suspended_threads==1) return max_request;
-		if (lowest>limit/3) return max_request;	//there is no room for another thread, so give all memory to this one
-		return min(lowest*2,max_request);				
+		AdmissionState state;
+		state.limit=limit;
+		state.allocated=allocated;
+		state.base_memory_limit=base_memory_limit;
+		state.lowest=ComputationRunner::singleton().lowest_effective_memory_limit();
+		state.suspended_threads=suspended_threads;
+		for (auto& p : running) state.running.insert(state.running.end(),p.second,p.first);
+		state.pending=ComputationRunner::singleton().pending_computations();
+		state.slow=ComputationRunner::singleton().slow_computations();
+		return policy->to_request(state);
 	}
 	MemoryManager()=default;
-	//start a thread with allocated amount of memory, or wait for enough memory to be freed. If memory is nullopt, just wait.
-	megabytes start_and_unlock(optional<megabytes> memory) {
-		if (finished()) {
-			suspension_mtx.unlock();
-			return 0;
-		}
-		if (memory && allocated+memory.value()<=limit) {
-			allocated+=memory.value();
-			--suspended_threads; 
-			suspension_mtx.unlock();
-			return memory.value();
-		}
-		else return wait_and_allocate();		
-	}	
-	megabytes wait_and_allocate() {
-		unique_lock<mutex> lck{suspension_mtx, std::adopt_lock};
-		while (true) {
-			suspension.wait_for(lck,std::chrono::seconds(10));
-			if (finished()) return 0;
-			auto request= to_request();
-			if (request) {
-				lck.release();	//maintain the lock after lck goes out of scope, letting start_and_unlock unlock it.
-				return start_and_unlock(request.value());
-			}
-		}
-	}	
-	void release(megabytes n) {
-		unique_lock<mutex> lck{suspension_mtx};
-		allocated-=n;
-		++suspended_threads;
-		suspension.notify_one();
+	//allocate memory to a suspended thread, or return nullopt if memory is nullopt or not enough memory is available; return 0 if the computation is finished, so that the thread should terminate
+	optional<megabytes> allocate(optional<megabytes> memory) {
+		if (finished()) return megabytes{0};
+		if (!memory || allocated+memory.value()>limit) return nullopt;
+		allocated+=memory.value();
+		++running[memory.value()];
+		--suspended_threads;
+		return memory;
 	}
 	MemoryUse get_memory_use() {
-		return {limit,base_memory_limit,allocated, free_kb_of_memory()/1024};		
+		return {limit,base_memory_limit,allocated, free_kb_of_memory()/1024, peak};		
 	}
 public:
 	static MemoryManager& singleton() {
 		static MemoryManager memory_manager;
 		return memory_manager;
 	}
-	megabytes start() {
-		suspension_mtx.lock();
+	//a new thread is suspended until it is allocated memory with start, or start_large_thread if it is the thread that takes all the memory left
+	void add_thread() {
+		unique_lock<mutex> lck{suspension_mtx};
 		++suspended_threads;
-		return start_and_unlock(base_memory_limit);
 	}
-	megabytes start_large_thread() {
-		suspension_mtx.lock();
+	//the following functions do not wait for memory to be freed: if not enough memory is available, they return nullopt, and the thread should call resume when memory may have been freed
+	optional<megabytes> start() {
+		unique_lock<mutex> lck{suspension_mtx};
+		return allocate(base_memory_limit);
+	}
+	optional<megabytes> start_large_thread() {
+		unique_lock<mutex> lck{suspension_mtx};
+		return allocate(max(base_memory_limit,limit-allocated));
+	}
+	//allocate to a suspended thread the memory chosen by the admission policy
+	optional<megabytes> resume() {
+		unique_lock<mutex> lck{suspension_mtx};
+		return allocate(to_request());
+	}
+	//release the memory allocated to a thread, which is suspended until it is allocated memory again
+	void release(megabytes n) {
+		unique_lock<mutex> lck{suspension_mtx};
+		allocated-=n;
+		if (--running[n]==0) running.erase(n);
 		++suspended_threads;
-		return start_and_unlock(max(base_memory_limit,limit-allocated));
-	}	
-	megabytes resize(megabytes actual_size) {
-		release(actual_size);
-		suspension_mtx.lock();
-		return start_and_unlock(to_request());
 	}
-	MemoryUse set_memory_limit(megabytes total_limit, megabytes per_thread_limit) {
+	//set the function to call when the memory limits are changed, so that suspended threads can be resumed
+	void on_memory_available(std::function<void()> callback) {
+		unique_lock<mutex> lck{suspension_mtx};
+		memory_available=std::move(callback);
+	}
+	//record the memory actually used by a batch, as opposed to the memory allocated to it
+	void record_usage(const ProcessUsage& usage) {
+		unique_lock<mutex> lck{suspension_mtx};
+		peak=max(peak,megabytes(usage.max_rss_kb/1024));
+	}
+	MemoryUse set_memory_limit(megabytes total_limit, megabytes per_thread_limit, unique_ptr<AdmissionPolicy> admission_policy) {
 		unique_lock<mutex> lck{suspension_mtx};
+		policy=std::move(admission_policy);
 		limit=total_limit;
 		base_memory_limit=per_thread_limit;
 		return get_memory_use();
@@ -90,7 +96,7 @@ public:
 		unique_lock<mutex> lck{suspension_mtx};
 		if (limit+total_memory_delta>0) limit+=total_memory_delta;
 		base_memory_limit=std::max(base_memory_limit+base_memory_delta,ComputationRunner::singleton().lowest_effective_memory_limit());
-		if (total_memory_delta>0 || base_memory_delta<0) suspension.notify_one();
+		if ((total_memory_delta>0 || base_memory_delta<0) && memory_available) memory_available();
 		return get_memory_use();
 	}
 };
@@ -0,0 +1,87 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef MEMORY_SAMPLER_H
+#define MEMORY_SAMPLER_H
+
+#include "stdincludes.h"
+#include "processusage.h"
+#include <condition_variable>
+#include <sys/resource.h>
+#include <boost/process/extend.hpp>
+
+//Magma only enforces the memory limit set by the work script; the sampler reads the resident set size of the running Magma processes at regular intervals, and kills those that exceed their limit, so that a misbehaving work script cannot exhaust the memory of the machine.
+//Processes must be removed from the sampler before they are reaped: since a process that has terminated keeps its pid until it is reaped, the sampler never signals a pid that has been reused
+class MemorySampler {
+	struct SampledProcess {
+		long limit_kb;
+		bool exceeded=false;
+	};
+	std::chrono::milliseconds interval;
+	mutex mtx;
+	condition_variable cv;
+	map<pid_t,SampledProcess> processes;
+	bool stopping=false;
+	thread sampler_thread{&MemorySampler::loop,this};
+
+	void loop() {
+		unique_lock<mutex> lock{mtx};
+		while (!cv.wait_for(lock,interval,[this] () {return stopping;}))
+			for (auto& process : processes)
+				if (!process.second.exceeded && rss_kb(process.first)>process.second.limit_kb) {
+					::kill(process.first,SIGKILL);
+					process.second.exceeded=true;
+				}
+	}
+public:
+	MemorySampler(std::chrono::milliseconds interval) : interval{interval} {}
+	MemorySampler(const MemorySampler&)=delete;
+	~MemorySampler() {
+		{
+			unique_lock<mutex> lock{mtx};
+			stopping=true;
+		}
+		cv.notify_one();
+		sampler_thread.join();
+	}
+	void add(pid_t pid, long limit_kb) {
+		unique_lock<mutex> lock{mtx};
+		processes[pid]={limit_kb};
+	}
+	//stop sampling the process; return true if it was killed for exceeding its limit
+	bool remove(pid_t pid) {
+		unique_lock<mutex> lock{mtx};
+		auto it=processes.find(pid);
+		if (it==processes.end()) return false;
+		bool exceeded=it->second.exceeded;
+		processes.erase(it);
+		return exceeded;
+	}
+};
+
+//initializer for boost::process::child limiting the address space of the child process to the given number of bytes, or doing nothing if bytes is zero
+auto limit_address_space(rlim_t bytes) {
+	return boost::process::extend::on_exec_setup=[bytes] (auto&) {
+		if (bytes) {
+			rlimit limit{bytes,bytes};
+			::setrlimit(RLIMIT_AS,&limit);
+		}
+	};
+}
+
+#endif
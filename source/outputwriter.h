@@ -0,0 +1,130 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+#include "stdincludes.h"
+#include "computation.h"
+#include "segment.h"
+#include <functional>
+#include <iterator>
+
+//appends the output of work scripts to the work output directory on a dedicated thread, so that the thread reading the output of Magma processes does not wait for the disk.
+//Lines are queued as they are read; the writer thread takes all the queued lines at once and appends them to the current segment with a single write. When the segment exceeds the given size, it is closed and a new one is started.
+//If a write fails, the segment is truncated to the lines written before, and the lines are kept in the queue and written again after RETRY_INTERVAL; they are only given up when the writer is destroyed
+class OutputWriter {
+public:
+	//called on the writer thread after lines have been written to a segment, with the corresponding computations
+	using WrittenCallback=std::function<void(const string& segment, const vector<Computation>& computations)>;
+	static constexpr std::chrono::seconds RETRY_INTERVAL{10};
+private:
+	struct Entry {
+		string line;
+		Computation computation;
+	};
+	fs::path output_dir;
+	string extension;
+	std::uintmax_t segment_size;
+	bool sync;
+	WrittenCallback on_written;
+	unique_ptr<SegmentWriter> segment;
+	mutex mtx;
+	condition_variable cv;
+	vector<Entry> queue;
+	bool stopping=false;
+	thread writer_thread{&OutputWriter::loop,this};
+
+	//return false if the entries could not be written; the current segment is then rolled back to the lines written before, or abandoned if that fails
+	bool write_entries(const vector<Entry>& entries) {
+		vector<Computation> computations;
+		computations.reserve(entries.size());
+		try {
+			if (!segment) segment=make_unique<SegmentWriter>(new_segment_name(output_dir,extension));
+			for (auto& entry : entries) {
+				segment->add(entry.line,entry.computation.to_string());
+				computations.push_back(entry.computation);
+			}
+			segment->write(sync);
+		}
+		catch (const Exception& e) {
+			std::cerr<<e.what()<<endl;
+			if (segment && segment->broken()) segment.reset();
+			return false;
+		}
+		try {
+			on_written(segment->filename(),computations);
+			if (segment->size()>=segment_size) close_segment();
+		}
+		catch (const Exception& e) {
+			std::cerr<<e.what()<<endl;
+		}
+		return true;
+	}
+	void close_segment() {
+		segment->close(sync);
+		on_written(segment->filename(),{});
+		segment.reset();
+	}
+	void loop() {
+		unique_lock<mutex> lock{mtx};
+		while (true) {
+			cv.wait(lock,[this] () {return stopping || !queue.empty();});
+			if (queue.empty()) break;
+			vector<Entry> entries;
+			entries.swap(queue);
+			lock.unlock();
+			bool written=write_entries(entries);
+			lock.lock();
+			if (written) continue;
+			if (stopping) std::cerr<<"the output of "<<entries.size()<<" computations could not be written"<<endl;
+			else {
+				queue.insert(queue.begin(),std::make_move_iterator(entries.begin()),std::make_move_iterator(entries.end()));
+				cv.wait_for(lock,RETRY_INTERVAL,[this] () {return stopping;});
+			}
+		}
+		try {
+			if (segment) close_segment();
+		}
+		catch (const Exception& e) {
+			std::cerr<<e.what()<<endl;
+		}
+	}
+public:
+	OutputWriter(const fs::path& output_dir, const string& extension, std::uintmax_t segment_size, bool sync, WrittenCallback on_written) : 
+		output_dir{output_dir}, extension{extension}, segment_size{segment_size}, sync{sync}, on_written{std::move(on_written)} {}
+	OutputWriter(const OutputWriter&)=delete;
+	//write all queued lines and close the current segment before returning
+	~OutputWriter() {
+		{
+			unique_lock<mutex> lock{mtx};
+			stopping=true;
+		}
+		cv.notify_one();
+		writer_thread.join();
+	}
+	void append(string&& line, const Computation& computation) {
+		{
+			unique_lock<mutex> lock{mtx};
+			queue.push_back({std::move(line),computation});
+		}
+		cv.notify_one();
+	}
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include "stdincludes.h"
 #include "csvschema.h"
 #include "system.h"
+#include "admissionpolicy.h"
 
 namespace po = boost::program_options;
 
@@ -32,10 +33,25 @@ struct ScriptParameters {
 	string output_dir;
 	string flags;
 	string work_output_extension;
+	bool server_mode=false;	//if true, each worker keeps a Magma process running and feeds it the data files through standard input
+	bool sync_output=false;	//if true, work output is flushed to disk before it is recorded in the index
+	int segment_size=256;	//size in MB after which a new work output segment is started
+	bool framing=false;	//if true, the work script is asked to write its output as length-prefixed records; set according to the version of the layer
+	bool dispatch_ids=false;	//if true, the work script is asked to identify started computations by their offset in the data file; set according to the version of the layer
 
 	string script_invocation(const string& data_filename, megabytes memory_limit) const {
 		return "megabytes:="s+to_string(memory_limit)
 			+" dataFile:="s +data_filename 
+			+(framing? " framing:=true"s : ""s)
+			+(dispatch_ids? " dispatchIds:=true"s : ""s)
+			+ " "s +flags
+			+ " "s +script;
+	}
+	string server_invocation(megabytes memory_limit) const {
+		return "megabytes:="s+to_string(memory_limit)
+			+" server:=true"s
+			+(framing? " framing:=true"s : ""s)
+			+(dispatch_ids? " dispatchIds:=true"s : ""s)
 			+ " "s +flags
 			+ " "s +script;
 	}
@@ -54,11 +70,19 @@ struct ComputationParameters {
 	megabytes base_memory_limit;
 	megabytes total_memory_limit;
 	std::chrono::duration<int> base_timeout;
+	int rss_limit=0;	//percentage of its memory limit that a Magma process may use before being killed, or 0 to disable the check
+	int address_space_limit=0;	//percentage of its memory limit to which the address space of a Magma process is limited, or 0 for no limit
+	string admission_policy=ADMISSION_POLICIES[0];	//policy deciding how much memory to give to each thread
+	std::chrono::seconds batch_duration{0};	//if nonzero, the number of computations per process is adjusted so that each batch takes about this time
+	int timeout_escalations=3;	//number of times the timeout of a computation that ran out of time is doubled before giving up
 };
 
 struct CommunicationParameters {
 	string valhalla;	//files where interrupted computations are stored
 	string huginn;		//directory where files to communicate with processes are stored	
+	string index;		//file where the index of the work output directory is stored
+	string batch_log;	//file where the resources used by each batch are logged
+	string costs;	//file where the computations that failed are recorded across runs, or empty
 };
 
 enum class OperatingMode {
@@ -101,6 +125,9 @@ Parameters command_line_parameters(int argv, char** argc) {
     ("workoutput", po::value<string>(), "output directory of work script (defaults to the stem of <computations>, i.e. <computations> without the extension)")
 		("flags", po::value<string>()->default_value(""), "flags to be passed to work script")
 		("extension", po::value<string>()->default_value(".work"), "extension of files generated by the work script")
+		("segment-size", po::value<int>()->default_value(256), "size in MB of the segments the work output is divided into")
+		("fsync", "flush the work output to disk after each write, before recording it in the index")
+		("server", "keep one Magma process running for each worker, and feed it the computations through standard input (requires a work script using ProcessDataFiles)")
 
 			//input parameters			
     ("computations", po::value<string>(), "input file containing the list of computations")
@@ -108,21 +135,31 @@ Parameters command_line_parameters(int argv, char** argc) {
     ("db", po::value<string>()->default_value(""), "directory containing database of already performed computations; if empty string or unspecified, database is not used. Computations listed in the database are not repeated")
     
 			//computation parameters
-    ("nthreads", po::value<int>()->default_value(10), "number of worker threads and magma processes to be run")
+    ("nthreads", po::value<int>()->default_value(10), "number of workers, i.e. of magma processes to be run in parallel")
     ("workload", po::value<int>()->default_value(100), "computations per process")
+    ("batch-duration", po::value<int>()->default_value(0), "if set, adjust the number of computations per process so that each process runs for about this number of seconds, starting from <workload>")
     ("free-memory", po::value<int>()->default_value(0), "if set, quit all computations when system free memory goes below this threshold in GB")
     ("total-memory", po::value<int>()->default_value(4), "total memory limit in GB for all threads")
     ("memory", po::value<int>()->default_value(128), "base memory limit in MB for each thread")
 	("base-timeout", po::value<int>()->default_value(0),"base timeout limit in seconds, or 0 for no limit")
+	("timeout-escalations", po::value<int>()->default_value(3),"number of times the timeout of a computation that ran out of time is doubled before the computation is skipped")
+	("rss-limit", po::value<int>()->default_value(0),"kill Magma processes whose resident set size exceeds this percentage of their memory limit, or 0 to disable")
+	("address-space-limit", po::value<int>()->default_value(0),"limit the address space of Magma processes to this percentage of their memory limit, or 0 for no limit")
+	("admission", po::value<string>()->default_value(ADMISSION_POLICIES[0]),"policy deciding how much memory to give to each thread: heuristic or packing")
 			
 			//communication parameters
-    ("valhalla", po::value<string>() , "file where unterminated computations are to be stored (defaults to <output>.valhalla)");
+    ("valhalla", po::value<string>() , "file where unterminated computations are to be stored (defaults to <output>.valhalla)")
+    ("index", po::value<string>() , "file where the index of computations found in the work output directory is stored (defaults to <output>.index)")
+    ("batch-log", po::value<string>() , "file where the time and memory used by each batch are logged (defaults to <output>.batches)")
+    ("costs", po::value<string>() , "file where computations that could not be completed are recorded, so that later runs assign them directly a higher memory limit (defaults to <output>.costs; an empty string disables it)");
 
 	po::variables_map vm;
 	po::store(po::parse_command_line(argv, argc, desc), vm);
 	po::notify(vm);    	
 
-	if (vm.count("help") || !vm.count("computations") || !vm.count("script") || !vm.count("schema"))
+	if (vm.count("help") || !vm.count("computations") || !vm.count("script") || !vm.count("schema")
+		|| std::find(ADMISSION_POLICIES.begin(),ADMISSION_POLICIES.end(),vm["admission"].as<string>())==ADMISSION_POLICIES.end()
+		|| vm["segment-size"].as<int>()<=0)
 		throw InvalidParametersException(desc);
 	string output_dir;	
 	if (!vm.count("workoutput")) output_dir=boost::filesystem::path(vm["computations"].as<string>()).stem().native();
@@ -130,14 +167,23 @@ Parameters command_line_parameters(int argv, char** argc) {
 	string valhalla;
 	if (!vm.count("valhalla")) valhalla=output_dir+".valhalla";
 	else valhalla=vm["valhalla"].as<string>();
+	string index;
+	if (!vm.count("index")) index=output_dir+".index";
+	else index=vm["index"].as<string>();
+	string batch_log;
+	if (!vm.count("batch-log")) batch_log=output_dir+".batches";
+	else batch_log=vm["batch-log"].as<string>();
+	string costs;
+	if (!vm.count("costs")) costs=output_dir+".costs";
+	else costs=vm["costs"].as<string>();
 	
 	Parameters result;
 	if (vm.count("batch-mode")) result.operating_mode=OperatingMode::BATCH_MODE;
 	result.stdio=vm.count("stdio");
-	result.script_parameters={vm["script"].as<string>(), output_dir,vm["flags"].as<string>(), vm["extension"].as<string>()};
+	result.script_parameters={vm["script"].as<string>(), output_dir,vm["flags"].as<string>(), vm["extension"].as<string>(), vm.count("server")>0, vm.count("fsync")>0, vm["segment-size"].as<int>()};
 	result.input_parameters={vm["computations"].as<string>(), vm["schema"].as<string>(),vm["db"].as<string>()};
-	result.computation_parameters={vm["nthreads"].as<int>(), vm["workload"].as<int>(),  vm["free-memory"].as<int>()*1024*1024, vm["memory"].as<int>(), vm["total-memory"].as<int>()*1024, std::chrono::seconds(vm["base-timeout"].as<int>())};
-	result.communication_parameters={valhalla,random_non_existing_file()};
+	result.computation_parameters={vm["nthreads"].as<int>(), vm["workload"].as<int>(),  vm["free-memory"].as<int>()*1024*1024, vm["memory"].as<int>(), vm["total-memory"].as<int>()*1024, std::chrono::seconds(vm["base-timeout"].as<int>()), vm["rss-limit"].as<int>(), vm["address-space-limit"].as<int>(), vm["admission"].as<string>(), std::chrono::seconds(vm["batch-duration"].as<int>()), vm["timeout-escalations"].as<int>()};
+	result.communication_parameters={valhalla,random_non_existing_file(),index,batch_log,costs};
 	return result;	
 }
 #endif
@@ -0,0 +1,123 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef PROCESS_REACTOR_H
+#define PROCESS_REACTOR_H
+
+#include "stdincludes.h"
+#include "processusage.h"
+#include <functional>
+#include <sys/syscall.h>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/buffers_iterator.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/process/async_pipe.hpp>
+
+//reads the standard output of all child processes and waits for them to exit on a single thread, so that no thread waits for each running process.
+//The functions of this class return at once; the handlers they are given are run on the reactor thread
+class ProcessReactor {
+	boost::asio::io_context context;
+	boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work{context.get_executor()};
+	thread reactor_thread{[this] () {context.run();}};
+
+	//state of a call to read_lines, shared with the handlers running on the reactor thread
+	struct Reading {
+		boost::process::async_pipe& pipe;
+		boost::asio::streambuf& buffer;
+		std::function<bool(string&&)> on_line;
+		std::function<optional<std::size_t>()> record_length;
+		std::function<void(bool)> on_done;
+		Reading(boost::process::async_pipe& pipe, boost::asio::streambuf& buffer, std::function<bool(string&&)> on_line, std::function<optional<std::size_t>()> record_length, std::function<void(bool)> on_done) :
+			pipe{pipe}, buffer{buffer}, on_line{std::move(on_line)}, record_length{std::move(record_length)}, on_done{std::move(on_done)} {}
+	};
+	static string extract_line(boost::asio::streambuf& buffer) {
+		istream is{&buffer};
+		string line;
+		std::getline(is,line);
+		return line;
+	}
+	//extract length bytes, followed by a newline which is discarded
+	static string extract_record(boost::asio::streambuf& buffer, std::size_t length) {
+		auto data=buffer.data();
+		string record{boost::asio::buffers_begin(data),boost::asio::buffers_begin(data)+length};
+		bool newline=buffer.size()>length && *(boost::asio::buffers_begin(data)+length)=='\n';
+		buffer.consume(length+(newline? 1 : 0));
+		return record;
+	}
+	static void handle_read(std::shared_ptr<Reading> reading, const boost::system::error_code& error, optional<std::size_t> record_length) {
+		if (error) {	//the pipe was closed, normally because the process has exited; a last line not terminated by a newline, or a truncated record, is still passed on
+			if (reading->buffer.size()) reading->on_line(extract_line(reading->buffer));
+			reading->on_done(false);
+		}
+		else if (reading->on_line(record_length? extract_record(reading->buffer,record_length.value()) : extract_line(reading->buffer))) read_next(reading);
+		else reading->on_done(true);
+	}
+	//read a line, or a record of the length given by record_length, including the newline that follows it; a record is read by length, so it may contain newlines
+	static void read_next(std::shared_ptr<Reading> reading) {
+		optional<std::size_t> record_length;
+		if (reading->record_length) record_length=reading->record_length();
+		if (!record_length)
+			boost::asio::async_read_until(reading->pipe,reading->buffer,'\n',[reading] (const boost::system::error_code& error, std::size_t) {
+				handle_read(reading,error,nullopt);
+			});
+		else if (reading->buffer.size()>record_length.value())
+			handle_read(reading,{},record_length);
+		else
+			boost::asio::async_read(reading->pipe,reading->buffer,boost::asio::transfer_exactly(record_length.value()+1-reading->buffer.size()),[reading,record_length] (const boost::system::error_code& error, std::size_t) {
+				handle_read(reading,error,record_length);
+			});
+	}
+public:
+	ProcessReactor()=default;
+	ProcessReactor(const ProcessReactor&)=delete;
+	~ProcessReactor() {
+		work.reset();
+		context.stop();
+		reactor_thread.join();
+	}
+	boost::asio::io_context& io_context() {return context;}
+	//pass the lines read from pipe to on_line, until on_line returns false or the pipe is closed, then call on_done with true in the first case. If record_length is given and returns a value, the next item is read as a record of that many bytes rather than as a line.
+	//Data read past the last line remains in buffer, so that it can be reused by a later call; pipe and buffer must stay alive until on_done is called
+	void read_lines(boost::process::async_pipe& pipe, boost::asio::streambuf& buffer, std::function<bool(string&&)> on_line, std::function<optional<std::size_t>()> record_length, std::function<void(bool)> on_done) {
+		auto reading=std::make_shared<Reading>(pipe,buffer,std::move(on_line),std::move(record_length),std::move(on_done));
+		boost::asio::post(context,[reading] () {read_next(reading);});
+	}
+	//call on_exit once the child process with the given pid has terminated, without reaping it, with false if waiting failed.
+	//The process is watched through a pidfd; on kernels that do not support it, the reactor thread waits for the process, which is normally about to exit since it has closed its output
+	void wait_for_exit(pid_t pid, std::function<void(bool)> on_exit) {
+		int pidfd=-1;
+#ifdef SYS_pidfd_open
+		pidfd=syscall(SYS_pidfd_open,pid,0);
+#endif
+		if (pidfd<0) {
+			boost::asio::post(context,[pid,on_exit=std::move(on_exit)] () {on_exit(wait_for_termination(pid));});
+			return;
+		}
+		auto descriptor=std::make_shared<boost::asio::posix::stream_descriptor>(context,pidfd);
+		descriptor->async_wait(boost::asio::posix::stream_descriptor::wait_read,[descriptor,on_exit=std::move(on_exit)] (const boost::system::error_code& error) {
+			on_exit(!error);
+		});
+	}
+};
+
+#endif
@@ -0,0 +1,148 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef PROCESS_USAGE_H
+#define PROCESS_USAGE_H
+
+#include "stdincludes.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cerrno>
+
+//the limit hit by a process that could not complete a batch
+enum class FailureCause {MEMORY, TIME};
+
+//true if line is one of the errors printed by Magma when it runs out of memory or exceeds the limit set by SetMemoryLimit
+bool is_memory_error(const string& line) {
+	return line.find("Out of memory")!=string::npos || line.find("failed memory request")!=string::npos;
+}
+
+//true if the file contains a memory error after the given offset
+bool memory_error_in(const string& filename, std::streamoff from=0) {
+	ifstream s{filename};
+	s.seekg(from);
+	string line;
+	while (std::getline(s,line))
+		if (is_memory_error(line)) return true;
+	return false;
+}
+
+//resources used by the Magma process while running a batch
+struct ProcessUsage {
+	std::chrono::milliseconds wall_time{0};
+	std::chrono::milliseconds cpu_time{0};	//user plus system time
+	long max_rss_kb=0;	//peak resident set size, or 0 if unknown
+	optional<int> exit_status;	//set if the process exited normally
+	optional<int> signal;	//set if the process was killed by a signal
+	bool memory_exceeded=false;	//set if the process was killed because its resident set size exceeded the allowed limit
+	bool memory_error=false;	//set if the process printed an out of memory error
+	bool timed_out=false;	//set if the process was killed because the timeout expired
+
+	//a process that did not complete its batch is taken to have run out of memory, unless it was killed by the timer and there is no evidence that it ran out of memory first
+	FailureCause failure_cause() const {
+		return timed_out && !memory_exceeded && !memory_error? FailureCause::TIME : FailureCause::MEMORY;
+	}
+
+	string to_string() const {
+		std::stringstream s;
+		s<<std::fixed<<std::setprecision(1)<<wall_time.count()/1000.0<<"s, CPU "<<cpu_time.count()/1000.0<<"s, peak "<<max_rss_kb/1024<<" MB";
+		if (memory_exceeded) s<<", killed for exceeding its memory limit";
+		else if (memory_error) s<<", out of memory";
+		else if (timed_out) s<<", timed out";
+		else if (signal) s<<", killed by signal "<<signal.value();
+		else if (exit_status && exit_status.value()) s<<", exit status "<<exit_status.value();
+		return s.str();
+	}
+};
+
+//the following functions are system dependent; the ones reading /proc only work on linux
+
+std::chrono::milliseconds to_milliseconds(const timeval& time) {
+	return std::chrono::milliseconds{time.tv_sec*1000+time.tv_usec/1000};
+}
+
+//wait until a child process has terminated, without reaping it; as long as it is not reaped, its pid cannot be reused
+bool wait_for_termination(pid_t pid) {
+	siginfo_t info;
+	int result;
+	do result=waitid(P_PID,pid,&info,WEXITED | WNOWAIT);
+	while (result<0 && errno==EINTR);
+	return result==0;
+}
+
+//reap a terminated child process and fill in its exit status and the resources it used during its lifetime; return false if the process could not be reaped
+bool reap_child(pid_t pid, ProcessUsage& usage) {
+	int status;
+	rusage resources;
+	pid_t result;
+	do result=wait4(pid,&status,0,&resources);
+	while (result<0 && errno==EINTR);
+	if (result!=pid) return false;
+	if (WIFEXITED(status)) usage.exit_status=WEXITSTATUS(status);
+	else if (WIFSIGNALED(status)) usage.signal=WTERMSIG(status);
+	usage.cpu_time=to_milliseconds(resources.ru_utime)+to_milliseconds(resources.ru_stime);
+	usage.max_rss_kb=resources.ru_maxrss;
+	return true;
+}
+
+//CPU time used so far by a running process
+std::chrono::milliseconds cpu_time_of(pid_t pid) {
+	std::ifstream s{"/proc/"+std::to_string(pid)+"/stat"};
+	string stat;
+	std::getline(s,stat);
+	auto end_of_command=stat.rfind(')');	//the command name may contain spaces
+	if (end_of_command==string::npos) return {};
+	std::istringstream fields{stat.substr(end_of_command+2)};
+	string field;
+	for (int i=3;i<14;++i) fields>>field;	//skip fields 3 to 13
+	long utime=0, stime=0;
+	fields>>utime>>stime;
+	auto ticks_per_second=sysconf(_SC_CLK_TCK);
+	return std::chrono::milliseconds{(utime+stime)*1000/ticks_per_second};
+}
+
+//value in kB of a field such as VmRSS in /proc/<pid>/status, or 0 if it cannot be read
+long status_kb(pid_t pid, const string& field) {
+	std::ifstream s{"/proc/"+std::to_string(pid)+"/status"};
+	string line;
+	while (std::getline(s,line))
+		if (line.size()>field.size() && line.compare(0,field.size(),field)==0 && line[field.size()]==':') return std::stol(line.substr(field.size()+1));
+	return 0;
+}
+//peak resident set size of a running process in kB
+long peak_rss_kb(pid_t pid) {
+	return status_kb(pid,"VmHWM");
+}
+//current resident set size of a running process in kB
+long rss_kb(pid_t pid) {
+	return status_kb(pid,"VmRSS");
+}
+
+//reset the peak resident set size of a running process to its current resident set size
+void reset_peak_rss(pid_t pid) {
+	std::ofstream s{"/proc/"+std::to_string(pid)+"/clear_refs"};
+	s<<"5"<<std::endl;
+}
+
+#endif
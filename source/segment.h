@@ -0,0 +1,151 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include "stdincludes.h"
+#include "csv.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <regex>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+//A segment is a work output file collecting the output of many batches. Lines are only appended; when the segment is closed, a footer is appended, of the form
+//	#footer
+//	#<offset>;<key>
+//	...
+//	#end;<offset of the footer>
+//where each key is the input of a computation and offset is the position of the corresponding line. Lines starting with # are not work script output, and should be skipped by readers; a segment without a footer (e.g. because hliðskjálf was killed) is read like any other work output file.
+
+const string SEGMENT_PREFIX="segment-";
+
+bool is_segment_metadata(const string& line) {
+	return !line.empty() && line[0]=='#';
+}
+bool is_segment_metadata(const CSVLine& line) {
+	return line.size() && is_segment_metadata(line[0]);
+}
+
+//return the name of a new segment in the given directory, numbering segments consecutively
+string new_segment_name(const fs::path& directory, const string& extension) {
+	static const std::regex segment_name{SEGMENT_PREFIX+"([0-9]+)\\..*"};
+	int last=0;
+	for (auto& x : fs::directory_iterator(directory)) {
+		std::smatch match;
+		auto filename=x.path().filename().native();
+		if (std::regex_match(filename,match,segment_name)) last=max(last,stoi(match[1]));
+	}
+	return (directory/(SEGMENT_PREFIX+to_string(last+1)+extension)).native();
+}
+
+//return the keys listed in the footer of a segment, or nullopt if the file has no valid footer
+optional<vector<string>> read_segment_footer(const string& filename) {
+	ifstream s{filename,std::ios::binary};
+	s.seekg(0,std::ios::end);
+	std::streamoff size=s.tellg();
+	constexpr std::streamoff TAIL=64;
+	if (size<=0) return nullopt;
+	s.seekg(max(std::streamoff{0},size-TAIL));
+	string tail(min(size,TAIL),'\0');
+	s.read(tail.data(),tail.size());
+	auto end_position=tail.rfind("\n#end;");
+	if (end_position==string::npos || tail.back()!='\n') return nullopt;
+	std::streamoff footer_offset;
+	try {
+		footer_offset=std::stoll(tail.substr(end_position+6));
+	}
+	catch (...) {
+		return nullopt;
+	}
+	s.clear();
+	s.seekg(footer_offset);
+	string line;
+	if (!std::getline(s,line) || line!="#footer") return nullopt;
+	vector<string> keys;
+	while (std::getline(s,line) && line.substr(0,5)!="#end;") {
+		auto separator=line.find(';');
+		if (line.empty() || line[0]!='#' || separator==string::npos) return nullopt;
+		keys.push_back(line.substr(separator+1));
+	}
+	return keys;
+}
+
+//appends lines to a segment, writing them to disk only when write() is called; the footer is written by close().
+//If a write fails, the segment is truncated back to its size after the last successful write and the lines added since are dropped, so that the segment can still be used and closed; if it cannot be truncated, it is marked as broken
+class SegmentWriter {
+	string filename_;
+	int fd;
+	std::uintmax_t size_=0;
+	string buffer;
+	vector<pair<std::uintmax_t,string>> entries;	//offset and key of each line
+	bool broken_=false;
+
+	void rollback() {
+		buffer.clear();
+		while (!entries.empty() && entries.back().first>=size_) entries.pop_back();
+		if (::ftruncate(fd,size_)!=0) broken_=true;
+	}
+	void write_buffer(bool sync) {
+		std::size_t written=0;
+		while (written<buffer.size()) {
+			auto result=::write(fd,buffer.data()+written,buffer.size()-written);
+			if (result>=0) written+=result;
+			else if (errno!=EINTR) {
+				rollback();
+				throw FileException(filename_,"error writing");
+			}
+		}
+		size_+=buffer.size();
+		buffer.clear();
+		if (sync) ::fsync(fd);
+	}
+public:
+	SegmentWriter(const string& filename) : filename_{filename} {
+		fd=::open(filename.c_str(),O_WRONLY | O_APPEND | O_CREAT | O_EXCL | O_CLOEXEC,0644);
+		if (fd<0) throw FileException(filename,"cannot create segment");
+	}
+	SegmentWriter(const SegmentWriter&)=delete;
+	~SegmentWriter() {
+		::close(fd);
+	}
+	void add(const string& line, string key) {
+		entries.emplace_back(size_+buffer.size(),std::move(key));
+		(buffer+=line)+='\n';
+	}
+	void write(bool sync) {write_buffer(sync);}
+	//write the footer; no lines should be added afterwards
+	void close(bool sync) {
+		auto footer_offset=size_+buffer.size();
+		buffer+="#footer\n";
+		for (auto& entry: entries) buffer+="#"+to_string(entry.first)+";"+entry.second+"\n";
+		buffer+="#end;"+to_string(footer_offset)+"\n";
+		write_buffer(sync);
+		entries.clear();
+	}
+	const string& filename() const {return filename_;}
+	//true if a write failed and the segment could not be restored to its state before the write
+	bool broken() const {return broken_;}
+	//number of bytes written, or to be written, to the segment
+	std::uintmax_t size() const {return size_+buffer.size();}
+};
+
+#endif
@@ -33,9 +33,11 @@
 #include <limits>
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
 #include <future>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 
 using std::string;
 using namespace std::literals;
@@ -51,10 +53,13 @@ using std::nullopt;
 using std::mutex;
 using std::unique_lock;
 using std::scoped_lock;
+using std::shared_mutex;
+using std::shared_lock;
 using std::future;
 using std::thread;
 using std::promise;
 using std::atomic;
+using std::condition_variable;
 
 using std::max;
 using std::min;
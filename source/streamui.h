@@ -25,6 +25,7 @@ class StreamUserInterface : public UserInterface {
 	ostream& os;
 	mutable mutex lock;
 	int pos=0;
+	UnpackingStatistics unpacking_statistics;	//shown on the status line at each tick
 public:
 	StreamUserInterface(ostream& os) : os{os} {}
 	void loaded_computations(const string& input_file) override {
@@ -46,7 +47,11 @@ public:
 	void tick(int packed_computations, int unpacked_computations, int bad, int abandoned) override {
     static char bars[] = { '/', '-', '\\', '|' };	
 		unique_lock<mutex> lck{lock};
-		os<<bars[pos]<<"\r";
+		os<<bars[pos];
+		if (unpacking_statistics.batches)
+			os<<" unpacking: "<<unpacking_statistics.batches<<" batches in "<<unpacking_statistics.time_unpacking.count()<<"ms, workers waited "<<unpacking_statistics.time_waited_by_workers.count()<<"ms, "
+				<<unpacking_statistics.completed<<" completed in "<<unpacking_statistics.completed_memory<<"MB";
+		os<<"\r";
 		os.flush();
 		pos = (pos + 1) % 4;
 	}	
@@ -57,8 +62,16 @@ public:
 		unique_lock<mutex> lck{lock};
 		os<<computation.to_string()<<endl;
 	}
+	void update_unpacking_statistics(const UnpackingStatistics& statistics) override {
+		unique_lock<mutex> lck{lock};
+		unpacking_statistics=statistics;
+	}
+	void discarded_output(const string& line, const string& reason) override {
+		unique_lock<mutex> lck{lock};
+		os<<"discarding output ("<<reason<<"): "<<line<<endl;
+	}
 	void display_memory_limit(MemoryUse memory) override {
-		os<<"Total limit: "<<memory.limit<<"MB ("<<memory.allocated<<"allocated, "<<memory.free<<" free)\tLower limit per thread: "<<memory.base_memory_limit<<"MB"<<endl;
+		os<<"Total limit: "<<memory.limit<<"MB ("<<memory.allocated<<"allocated, "<<memory.free<<" free)\tLower limit per thread: "<<memory.base_memory_limit<<"MB\tPeak use: "<<memory.peak<<"MB"<<endl;
 	}	
 	string get_filename(const string& text) override {
 		return {};
@@ -79,13 +92,13 @@ class ThreadStreamUIHandle : public ThreadUIHandle {
 	}
 public:
 	ThreadStreamUIHandle(const StreamUserInterface* ui, int thread) : ui{ui}, thread{thread} {}
- 	void computations_added(int assigned_computations, megabytes memory_limit,std::chrono::duration<int> timeout) override {
+ 	void computations_added(int assigned_computations, megabytes memory_limit,std::chrono::seconds timeout) override {
 		if (assigned_computations) {
 			unique_lock<mutex> lck{ui->lock};
 			print_thread_id();
 			ui->os<<"process with "<<memory_limit<<"MB ";
-			if (timeout!=std::chrono::duration<int>::zero())
-				ui->os<<"and timeout "<<std::chrono::duration_cast<std::chrono::seconds>(timeout).count()<<"s ";
+			if (timeout!=std::chrono::seconds::zero())
+				ui->os<<"and timeout "<<timeout.count()<<"s ";
 			ui->os<<"started with "<<assigned_computations<<" computations"<<endl; 			
 		}
  	}
@@ -99,18 +112,18 @@ public:
 		print_thread_id();
 		ui->os<<"stopped thread with a limit of "<<memory<<"MB"<<endl;
 	}
-	void bad_computation(const Computation& computation, megabytes memory_limit,std::chrono::duration<int> timeout) override {
+	void bad_computation(const Computation& computation, megabytes memory_limit,std::chrono::seconds timeout, const ProcessUsage& usage) override {
 		unique_lock<mutex> lck{ui->lock};
 		print_thread_id();
 		ui->os<<"could not complete "<<computation.to_string()<<" with "<<memory_limit<<" MB of memory";
-		if (timeout!=std::chrono::duration<int>::zero())
-				ui->os<<" in less than "<<std::chrono::duration_cast<std::chrono::seconds>(timeout).count()<<"s";
-		ui->os<<endl;
+		if (timeout!=std::chrono::seconds::zero())
+				ui->os<<" in less than "<<timeout.count()<<"s";
+		ui->os<<" ("<<usage.to_string()<<")"<<endl;
 	}
-	void finished_computations(int no_computations, megabytes memory) override {
+	void finished_computations(int no_computations, megabytes memory, const ProcessUsage& usage) override {
 		unique_lock<mutex> lck{ui->lock};
 		print_thread_id();
-		ui->os<<"finished "<<no_computations<<" with "<<memory<<" MB of memory"<<endl;		
+		ui->os<<"finished "<<no_computations<<" with "<<memory<<" MB of memory ("<<usage.to_string()<<")"<<endl;		
 	}
 	void thread_terminated() override {
 		unique_lock<mutex> lck{ui->lock};
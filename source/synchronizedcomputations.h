@@ -25,6 +25,9 @@
 #include "ui.h"
 #include "hash.h"
 #include "csvreader.h"
+#include "flathashset.h"
+#include "intervalset.h"
+#include "costmodel.h"
 
 template<typename Iterator> Iterator n_th_element_or_end(Iterator begin, Iterator end, int n) {
 	assert(n>=0);
@@ -91,16 +94,180 @@ public:
 	}
 };
 
-using AssignedComputations = unordered_set<Computation,boost::hash<Computation>>;
+//the time limit of a batch: the timeout for the given memory limit, doubled level times. A computation that ran out of time keeps the memory limit it failed with, so that retrying it in a larger process does not lengthen its timeout
+struct TimeLimit {
+	megabytes memory_limit;
+	int level=0;
+};
+
+//computations that could not be completed before the timeout expired; they are retried one at a time, with the same memory limit and a longer timeout
+class SlowComputations {
+public:
+	struct SlowComputation {
+		Computation computation;
+		megabytes memory_limit;
+		int timeout_level;	//the computation should be retried with the timeout multiplied by 2^timeout_level
+	};
+private:
+	map<megabytes,list<SlowComputation>> computations_by_memory_limit;
+	int size_=0;
+	mutable mutex mtx;
+public:
+	void insert(Computation&& computation, megabytes memory_limit, int timeout_level) {
+		unique_lock<mutex> lock{mtx};
+		computations_by_memory_limit[memory_limit].push_back({std::move(computation),memory_limit,timeout_level});
+		++size_;
+	}
+	//remove and return a computation that timed out with at most the given memory limit, and should be retried with at most the given timeout level
+	optional<SlowComputation> extract_within_memory_limit(megabytes memory_limit, int max_timeout_level) {
+		unique_lock<mutex> lock{mtx};
+		for (auto& p : computations_by_memory_limit) {
+			if (p.first>memory_limit) break;
+			auto it=std::find_if(p.second.begin(),p.second.end(),[max_timeout_level] (const SlowComputation& slow) {return slow.timeout_level<=max_timeout_level;});
+			if (it==p.second.end()) continue;
+			auto result=std::move(*it);
+			p.second.erase(it);
+			--size_;
+			return result;
+		}
+		return nullopt;
+	}
+	list<SlowComputation> remove_exceeding_timeout_level(int timeout_level) {
+		unique_lock<mutex> lock{mtx};
+		list<SlowComputation> result;
+		for (auto& p : computations_by_memory_limit)
+			for (auto i=p.second.begin();i!=p.second.end();)
+				if (i->timeout_level>timeout_level) result.splice(result.end(),p.second,i++);
+				else ++i;
+		size_-=result.size();
+		return result;
+	}
+	megabytes lowest_effective_memory_limit() const {
+		unique_lock<mutex> lock{mtx};
+		for (auto& p:computations_by_memory_limit) if (!p.second.empty()) return p.first;
+		return 0;
+	}
+	vector<pair<megabytes,int>> summary() const {
+		unique_lock<mutex> lock{mtx};
+		vector<pair<megabytes,int>> result;
+		for (auto & p:computations_by_memory_limit) if (p.second.size()) result.emplace_back(p.first,p.second.size());
+		return result;		
+	}
+	void clear() {computations_by_memory_limit.clear(); size_=0;}
+	int size() const {return size_;}
+	bool empty() const {
+		return size_==0;
+	}
+};
+
+using ComputationSet = FlatHashSet<Computation,boost::hash<Computation>>;
+using AssignedComputations = ComputationSet;
+
+//memory taken by a Computation with two secondary inputs, including the overhead of the container. This is a third of the 192 bytes taken by a Computation holding its inputs as strings,
+//short of a tenfold reduction: the cached hash and the inline inputs alone take 24 bytes, and the hash set is kept at most 7/8 full
+constexpr int BYTES_PER_COMPUTATION=64;
+constexpr int BYTES_PER_INTERVAL=48;	//memory taken by an interval in an IntervalSet, including the overhead of the map
+
+//computations known to be completed, either because they appear in the work output directory or because they were completed during this run.
+//They are kept in memory for the whole run, so their footprint is reported by memory_used() and subtracted from the budget for unpacked computations
+class CompletedComputations {
+	using IntervalsAlongAxis=std::unordered_map<Computation,IntervalSet,boost::hash<Computation>>;
+	ComputationSet computations;
+	//for each axis i, maps the computations with the i-th secondary input blanked out to the integer values of the i-th secondary input for which the computation is completed; only built for the axes along which templates are subtracted
+	map<int,IntervalsAlongAxis> intervals_along_axis;
+	mutable shared_mutex mtx;
+
+	static Computation key(const Computation& computation, int axis) {
+		vector<string> secondary_inputs;
+		for (int i=0;i<computation.no_secondary_inputs();++i)
+			secondary_inputs.push_back(i==axis? string{} : computation.secondary_input(i));
+		return {computation.primary_input(),secondary_inputs};
+	}
+	static Computation key(const ComputationTemplate& computation_template, int axis) {
+		vector<string> secondary_inputs;
+		for (int i=0;i<computation_template.no_secondary_inputs();++i)
+			secondary_inputs.push_back(i==axis? string{} : computation_template.value(i));
+		return {computation_template.primary_input(),secondary_inputs};
+	}
+	static void add_to_axis(IntervalsAlongAxis& intervals, const Computation& computation, int axis) {
+		if (computation.no_secondary_inputs()<=axis) return;
+		auto value=canonical_integer(computation.secondary_input(axis));
+		if (value) intervals[key(computation,axis)].insert(value.value());
+	}
+	IntervalsAlongAxis& intervals_along(int axis) {
+		auto i=intervals_along_axis.find(axis);
+		if (i!=intervals_along_axis.end()) return i->second;
+		auto& intervals=intervals_along_axis[axis];
+		for (auto& computation: computations) add_to_axis(intervals,computation,axis);
+		return intervals;
+	}
+public:
+	template<typename Computations> void insert(const Computations& completed) {
+		unique_lock<shared_mutex> lock{mtx};
+		computations.insert(completed.begin(),completed.end());
+		for (auto& p : intervals_along_axis)
+			for (auto& computation : completed) add_to_axis(p.second,computation,p.first);
+	}
+	template<typename Container> void eliminate_computations(Container& container) const {
+		shared_lock<shared_mutex> lock{mtx};
+		if (computations.size()<container.size())
+			for (auto& computation : computations) erase(container,computation);
+		else for (auto i=container.begin();i!=container.end();)
+			if (computations.count(*i)) i=container.erase(i);
+			else ++i;
+	}
+	//return the computations of computation_template not known to be completed, as a list of templates; computation_template should have at most one secondary input taking more than one value.
+	//Completed values of the multivalued secondary input are subtracted from its range without enumerating the computations
+	vector<ComputationTemplate> residual(ComputationTemplate&& computation_template) {
+		unique_lock<shared_mutex> lock{mtx};
+		vector<ComputationTemplate> result;
+		auto axes=computation_template.multivalued_fields();
+		assert(axes.size()<=1);
+		if (computations.empty()) result.push_back(std::move(computation_template));
+		else if (axes.empty()) {
+			if (!computations.count(key(computation_template,-1))) result.push_back(std::move(computation_template));
+		}
+		else {
+			int axis=axes[0];
+			auto& intervals=intervals_along(axis);
+			auto i=intervals.find(key(computation_template,axis));
+			if (i==intervals.end()) result.push_back(std::move(computation_template));
+			else {
+				auto range=computation_template.range(axis);
+				for (auto& subrange : i->second.complement(range.first,range.second))
+					result.push_back(computation_template.with_range(axis,subrange.first,subrange.second));
+			}
+		}
+		return result;
+	}
+	int size() const {
+		shared_lock<shared_mutex> lock{mtx};
+		return computations.size();
+	}
+	//estimate the memory taken by the set and by the intervals built from it, in bytes
+	std::uintmax_t memory_used() const {
+		shared_lock<shared_mutex> lock{mtx};
+		std::uintmax_t result=static_cast<std::uintmax_t>(computations.size())*BYTES_PER_COMPUTATION;
+		for (auto& p : intervals_along_axis) {
+			result+=static_cast<std::uintmax_t>(p.second.size())*BYTES_PER_COMPUTATION;
+			for (auto& q : p.second) result+=static_cast<std::uintmax_t>(q.second.no_intervals())*BYTES_PER_INTERVAL;
+		}
+		return result;
+	}
+};
 
 class UnpackedComputations {
-	unordered_set<Computation,boost::hash<Computation> > computations;
+	ComputationSet computations;
 	mutex mtx;
 public:
-	int unpack(const ComputationTemplate& packed) {
-		auto computation_instances=packed.computation_instances();
-		computations.insert(computation_instances.begin(),computation_instances.end());	
-		return computation_instances.size();
+	//unpack at most to_unpack computations, returning the number of computations taken from the cursor
+	int unpack(ComputationTemplateCursor& packed, int to_unpack) {
+		int unpacked=0;
+		while (unpacked<to_unpack && !packed.at_end()) {
+			computations.insert(packed.next());
+			++unpacked;
+		}
+		return unpacked;
 	}
 	int eliminate_computations_in_db(const SimpleDatabaseView& db_view, const set<int>& group_orders) {
 		int size=computations.size();
@@ -111,19 +278,26 @@ public:
 		db_view.iterate_through_entries(eliminate_function,group_orders);
 		return size-computations.size();
 	}
-	int eliminate_precalculated(const string& output_dir,const CSVSchema& schema, const atomic<bool>& terminate) {
+	int eliminate_precalculated(const CompletedComputations& completed) {
 		int size=computations.size();
-    for (auto& x : boost::filesystem::directory_iterator(output_dir))
-    	if (!terminate && boost::filesystem::is_regular_file(x)) {
-				std::ifstream f{x.path().native()};
-    		eliminate_computations<CSVReader>(f,computations,schema);
-    	}
+		completed.eliminate_computations(computations);
 		return size-computations.size();    		
 	}
+	//move the computations that are known to fail with some memory limit to bad, as if they had just failed with that limit
+	int set_aside_known_failures(const CostModel& cost_model, AbortedComputations& bad) {
+		int size=computations.size();
+		for (auto i=computations.begin();i!=computations.end();) {
+			auto limit=cost_model.failure_limit(*i);
+			if (!limit) ++i;
+			else {
+				bad.insert(*i,limit.value());
+				i=computations.erase(i);
+			}
+		}
+		return size-computations.size();
+	}
 	void assign (int to_add, AssignedComputations& assigned_computations) {	
-		auto i=computations.begin(),j=n_th_element_or_end(computations.begin(),computations.end(),to_add);
-		assigned_computations.insert(i,j);
-		computations.erase(i,j);	
+		computations.take(to_add,assigned_computations);
 	}
 	auto unique_lock() {
 		return std::unique_lock(mtx);
@@ -139,54 +313,152 @@ public:
 	int size() const {return computations.size();}
 	bool empty() const {return computations.empty();}
 	void insert(UnpackedComputations&& other) {
-		computations.insert(other.begin(),other.end());
+		if (computations.empty()) computations=std::move(other.computations);
+		else computations.insert(other.begin(),other.end());
 		other.clear();
 	}
 };
 
+//a file of computation templates, parsed incrementally as the templates are needed
+class ComputationFile {
+	ifstream stream;
+	const CSVSchema& schema;
+	std::uintmax_t size;
+	std::uintmax_t bytes_parsed=0;
+	std::uintmax_t computations_parsed=0;
+public:
+	ComputationFile(const string& filename, const CSVSchema& schema) : stream{filename}, schema{schema} {
+		boost::system::error_code error;
+		size=boost::filesystem::file_size(filename,error);
+		if (error) size=0;
+	}
+	bool at_end() {return !has_data_after_skipping_empty_lines(stream);}
+	ComputationTemplate next() {
+		string input;
+		getline(stream,input);
+		bytes_parsed+=input.size()+1;
+		auto computation_template=CSVReader::extract_computation_template(input,schema);
+		computations_parsed+=computation_template.no_computations();
+		return computation_template;
+	}
+	//estimate the number of computations in the part of the file not parsed yet, assuming the density of computations per byte is the same as in the part already parsed
+	std::uintmax_t estimated_remaining_computations() const {
+		if (!bytes_parsed || bytes_parsed>=size) return 0;
+		return static_cast<double>(size-bytes_parsed)*computations_parsed/bytes_parsed;
+	}
+};
+
+struct UnpackingResult {
+	set<int> primary_ids;	//primary inputs of the unpacked computations
+	int eliminated=0;	//number of computations found to be completed without unpacking them
+};
+
+//computation templates are read from the computation files a few at a time, so that memory use does not depend on the size of the files
 class PackedComputations {
-	int size_=0;
+	static constexpr int READ_AHEAD=1024;	//maximum number of templates read from the files in advance
+	int size_=0;	//number of computations in the templates read from the files and not unpacked yet
+	int estimated_unread=0;	//estimated number of computations in the part of the files not read yet
+	deque<ComputationFile> files;
 	deque<ComputationTemplate> packed_computations;
+	deque<ComputationTemplate> residual_computations;	//templates from which completed computations have already been subtracted
+	optional<ComputationTemplateCursor> partially_unpacked;	//the template currently being unpacked, if any
 	mutex mtx;
+
+	//read templates from the files, up to READ_AHEAD; invalid lines are reported on standard error and skipped, unless skip_invalid_lines is false
+	void read_ahead(bool skip_invalid_lines=true) {
+		while (packed_computations.size()<READ_AHEAD && !files.empty()) {
+			auto& file=files.front();
+			if (file.at_end()) {
+				files.pop_front();
+				continue;
+			}
+			try {
+				auto computation_template=file.next();
+				size_+=computation_template.no_computations();
+				packed_computations.push_back(std::move(computation_template));
+			}
+			catch (const Exception& e) {
+				if (!skip_invalid_lines) throw;
+				std::cerr<<e.what()<<endl;
+			}
+		}
+		std::uintmax_t unread=0;
+		for (auto& file : files) unread+=file.estimated_remaining_computations();
+		estimated_unread=min<std::uintmax_t>(unread,std::numeric_limits<int>::max()-size_);
+	}
+	//move the first template to residual_computations, after removing the completed computations; templates with several multivalued secondary inputs are split first, so that each part only has one
+	int subtract_completed_from_first_template(CompletedComputations& completed) {
+		auto& computation_template=packed_computations.front();
+		auto axes=computation_template.multivalued_fields();
+		if (axes.size()>1) {
+			auto first_value=computation_template.split_first_value(axes[0]);
+			packed_computations.push_front(std::move(first_value));
+			return 0;
+		}
+		int no_computations=computation_template.no_computations();
+		auto residual=completed.residual(std::move(computation_template));
+		packed_computations.pop_front();
+		for (auto& x : residual) {
+			no_computations-=x.no_computations();
+			residual_computations.push_back(std::move(x));
+		}
+		size_-=no_computations;
+		return no_computations;
+	}
 public:
+	//the number of computations not unpacked yet; this is an estimate while the computation files have not been read completely
 	int size() const {
-		return size_;
+		return size_+estimated_unread;
 	}
-	bool empty() const {return packed_computations.empty();}
+	bool empty() const {return files.empty() && packed_computations.empty() && residual_computations.empty() && !partially_unpacked;}
 
-	void load(istream& s, const CSVSchema& schema, int max_computations_in_template) {
+	//start reading a computation file; the first lines are parsed immediately, so that an invalid file is detected at this stage
+	void load(const string& input_file, const CSVSchema& schema) {
 		unique_lock<mutex> lock{mtx};
-		while (has_data_after_skipping_empty_lines(s)) {
-			string input;
-			getline(s,input);
-			auto computation_template=CSVReader::extract_computation_template(input,schema);
-			size_+=computation_template.no_computations();
-			for (auto& part : computation_template.split(max_computations_in_template))
-				packed_computations.push_back(part);
-		}
+		files.emplace_back(input_file,schema);
+		read_ahead(false);
 	}
 	
-	set<int> unpack(int threshold, UnpackedComputations& computations) {
+	//unpack computations until threshold is reached, possibly stopping in the middle of a template; computations known to be completed are skipped
+	UnpackingResult unpack(int threshold, UnpackedComputations& computations, CompletedComputations& completed) {
 		unique_lock<mutex> lock{mtx};
-		set<int> primary_ids;
-		while (computations.size()<threshold && !packed_computations.empty()) {
-			primary_ids.insert(packed_computations.front().primary_input());
-			size_-=computations.unpack(packed_computations.front());
-			packed_computations.pop_front();
+		UnpackingResult result;
+		while (computations.size()<threshold && !empty()) {
+			if (!partially_unpacked) {
+				if (residual_computations.empty()) {
+					if (packed_computations.empty()) {
+						read_ahead();
+						continue;
+					}
+					result.eliminated+=subtract_completed_from_first_template(completed);
+					continue;
+				}
+				partially_unpacked.emplace(std::move(residual_computations.front()));
+				residual_computations.pop_front();
+			}
+			result.primary_ids.insert(partially_unpacked->primary_input());
+			size_-=computations.unpack(partially_unpacked.value(),threshold-computations.size());
+			if (partially_unpacked->at_end()) partially_unpacked.reset();
 		}
-		return primary_ids;
+		return result;
 	}
 	void clear() {
 		unique_lock<mutex> lock{mtx};
+		files.clear();
 		packed_computations.clear();
+		residual_computations.clear();
+		partially_unpacked.reset();
 	}	
 };
 
 class SynchronizedComputations {
 	AbortedComputations bad;
+	SlowComputations slow;
+	CompletedComputations completed;
 	UnpackedComputations computations;
 	PackedComputations packed_computations;
 	UserInterface* ui=&NoUserInterface::singleton();
+	const CostModel* cost_model=nullptr;
 	int abandoned=0;
 	atomic<bool> should_terminate;
 	atomic<int> unpacking_threads=0;
@@ -198,31 +470,44 @@ protected:
 		should_terminate=true;
 		packed_computations.clear();
 		bad.clear();
+		slow.clear();
 		auto lock=computations.unique_lock();
 		computations.clear();
 	}
 	bool terminating() const {return should_terminate;}
+	//true if some computations have not been unpacked yet, or are being unpacked
+	bool unpacking_pending() const {return !packed_computations.empty() || unpacking_threads;}
+	UserInterface* user_interface() const {return ui;}
+	//computations unpacked from now on that are known to fail with some memory limit are only assigned to processes with a higher limit
+	void use_cost_model(const CostModel* model) {cost_model=model;}
+	CompletedComputations& completed_computations() {return completed;}
+	template<typename Computations> void mark_as_completed(const Computations& computations) {
+		completed.insert(computations);
+	}
 //to be called at initialization or when a new input_file is provided through the UI
-	void load_computations(const string& input_file,const CSVSchema& schema, int max_computations_in_template) {
-		ifstream s{input_file};
-		packed_computations.load(s,schema,max_computations_in_template);
+	void load_computations(const string& input_file,const CSVSchema& schema) {
+		packed_computations.load(input_file,schema);
 		ui->loaded_computations(input_file);
 	}
 //unpack computation templates into computations and remove those already processed
-	void unpack_computations_and_remove_already_processed(int min_threshold, int max_threshold, const optional<SimpleDatabaseView>& db_view,const string& output_dir,const CSVSchema& schema, ThreadUIHandle& thread_ui) {	
+	void unpack_computations_and_remove_already_processed(int min_threshold, int max_threshold, const optional<SimpleDatabaseView>& db_view, ThreadUIHandle& thread_ui) {	
 		++unpacking_threads;
 		UnpackedComputations unpacked;
 		while (computations.size()+unpacked.size()<min_threshold && !packed_computations.empty() && !should_terminate) {
 			thread_ui.unpacking_computations();
-			auto primary_ids=packed_computations.unpack(max_threshold, unpacked);
+			auto result=packed_computations.unpack(max_threshold, unpacked, completed);
 			thread_ui.unpacked_computations(unpacked.size());
-			if (!unpacked.size()) continue;
+			if (!unpacked.size()) {
+				if (result.eliminated) thread_ui.removed_precalculated(result.eliminated);
+				continue;
+			}
 			if (db_view) {
-				int eliminated=unpacked.eliminate_computations_in_db(db_view.value(),primary_ids);
+				int eliminated=unpacked.eliminate_computations_in_db(db_view.value(),result.primary_ids);
 				thread_ui.removed_computations_in_db(eliminated);
 			}
-			int eliminated=unpacked.eliminate_precalculated(output_dir,schema,should_terminate);
+			int eliminated=result.eliminated+unpacked.eliminate_precalculated(completed);
 	    thread_ui.removed_precalculated(eliminated);
+			if (cost_model && unpacked.set_aside_known_failures(*cost_model,bad)) ui->update_bad(failed_summary());
 			auto lock=computations.unique_lock();
 			computations.insert(std::move(unpacked));
 		}
@@ -240,33 +525,54 @@ protected:
     	}	
    	return last_process_id;	
 	}
-	virtual int to_valhalla(AbortedComputations& computations) =0;
+	virtual int to_valhalla(AbortedComputations& computations, SlowComputations& slow_computations) =0;
 public:
 	void attach_user_interface(UserInterface* interface=&NoUserInterface::singleton()) {
 		ui=interface;
-		ui->update_bad(bad.summary());
-	}
-	void mark_as_bad(Computation computation, megabytes memory_limit) {	
-		bad.insert(std::move(computation),memory_limit);		
-	}
-	void add_computations_to_do(AssignedComputations& assigned_computations, int computations_per_process, megabytes memory_limit) {
+		ui->update_bad(failed_summary());
+	}
+	//record a computation that could not be completed with the given memory limit and time limit: computations that ran out of memory are retried with a higher memory limit, and computations that ran out of time with a longer timeout
+	void mark_as_bad(Computation computation, megabytes memory_limit, FailureCause cause, const TimeLimit& time_limit) {	
+		if (cause==FailureCause::TIME) slow.insert(std::move(computation),time_limit.memory_limit,time_limit.level+1);
+		else bad.insert(std::move(computation),memory_limit);		
+		ui->update_bad(failed_summary());
+	}
+	//the computations that failed, either by running out of memory or out of time, grouped by memory limit
+	vector<pair<megabytes,int>> failed_summary() const {
+		map<megabytes,int> result;
+		for (auto& p : bad.summary()) result[p.first]+=p.second;
+		for (auto& p : slow.summary()) result[p.first]+=p.second;
+		return {result.begin(),result.end()};
+	}
+	//return the time limit with which the assigned computations should be run; a computation that ran out of time is assigned alone, so that the longer timeout only applies to it. Computations that ran out of time max_timeout_level times are left to to_valhalla
+	TimeLimit add_computations_to_do(AssignedComputations& assigned_computations, int computations_per_process, megabytes memory_limit, int max_timeout_level) {
+			if (assigned_computations.empty()) {
+				auto slow_computation=slow.extract_within_memory_limit(memory_limit,max_timeout_level);
+				if (slow_computation) {
+					assigned_computations.insert(std::move(slow_computation->computation));
+					ui->assigned_computations(1);
+					ui->update_bad(failed_summary());
+					return {slow_computation->memory_limit,slow_computation->timeout_level};
+				}
+			}
 			int to_add=max(0,computations_per_process- static_cast<int>(assigned_computations.size()));
 			auto resurrected=bad.extract_within_memory_limit(memory_limit, to_add);
 			to_add-=resurrected.size();
 			if (resurrected.size()) ui->resurrected(resurrected.size(),memory_limit);
-			ui->update_bad(bad.summary());
+			ui->update_bad(failed_summary());
 			assigned_computations.insert(resurrected.begin(),resurrected.end());
 			if (!computations.empty()) {
 				auto lock=computations.unique_lock();
 				computations.assign(to_add,assigned_computations);
 			}
 			if (assigned_computations.size()) ui->assigned_computations(assigned_computations.size());
+			return {memory_limit};
 	}
 	void tick() {
-		int removed=to_valhalla(bad);
+		int removed=to_valhalla(bad,slow);
 		abandoned+=removed;
 		if (removed) ui->aborted_computations(removed);
-		else ui->tick(packed_computations.size(), computations.size(),bad.size(),abandoned);
+		else ui->tick(packed_computations.size(), computations.size(),bad.size()+slow.size(),abandoned);
 	}
 	void print_computations() 	 {
 		auto lock=computations.unique_lock();
@@ -276,12 +582,25 @@ public:
 	int no_computations() const {
 		return computations.size();
 	}
+	//the computations that ran out of time, grouped by the memory limit they need
+	vector<pair<megabytes,int>> slow_computations() const {
+		return slow.summary();
+	}
+	//the computations to do, grouped by the highest memory limit they failed with; computations not attempted yet are listed with 0
+	vector<pair<megabytes,int>> pending_computations() const {
+		auto result=bad.summary();
+		int not_attempted=computations.size()+packed_computations.size();
+		if (not_attempted) result.insert(result.begin(),{0,not_attempted});
+		return result;
+	}
 	megabytes lowest_effective_memory_limit() {
 		if (!computations.empty() || !packed_computations.empty()) return 0;
-		return bad.lowest_effective_memory_limit();
+		auto lowest=bad.lowest_effective_memory_limit(), lowest_slow=slow.lowest_effective_memory_limit();
+		if (!lowest || !lowest_slow) return max(lowest,lowest_slow);
+		return min(lowest,lowest_slow);
 	}
 	bool finished() {
-		auto result=computations.empty() && !unpacking_threads && packed_computations.empty()  && bad.empty();
+		auto result=computations.empty() && !unpacking_threads && packed_computations.empty()  && bad.empty() && slow.empty();
 		return result || should_terminate;
 	}
 };
@@ -21,6 +21,11 @@
 
 #include "stdincludes.h"
 #include "exception.h"
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
 
 //system dependent; works on linux
 int free_kb_of_memory() {
@@ -71,4 +76,38 @@ bool file_exists(const string& filename) {
 		return false;
 	}
 }
+//a file residing in memory, which other processes can open by the path returned by path(). Only supported on linux; on other systems, or if the file cannot be created, valid() returns false
+class MemoryFile {
+	int fd=-1;
+public:
+	MemoryFile() {
+#ifdef MFD_CLOEXEC
+		fd=memfd_create("huginn",MFD_CLOEXEC);
+#endif
+	}
+	MemoryFile(const MemoryFile&)=delete;
+	~MemoryFile() {
+#ifdef __linux__
+		if (fd>=0) close(fd);
+#endif
+	}
+	bool valid() const {return fd>=0;}
+#ifdef __linux__
+	string path() const {return "/proc/"+to_string(getpid())+"/fd/"+to_string(fd);}
+	//replace the contents of the file; return false on error
+	bool write(const string& contents) {
+		if (ftruncate(fd,0)) return false;
+		std::size_t written=0;
+		while (written<contents.size()) {
+			auto result=pwrite(fd,contents.data()+written,contents.size()-written,written);
+			if (result>=0) written+=result;
+			else if (errno!=EINTR) return false;
+		}
+		return true;
+	}
+#else
+	string path() const {return {};}
+	bool write(const string& contents) {return false;}
+#endif
+};
 #endif
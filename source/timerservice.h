@@ -0,0 +1,166 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef TIMER_SERVICE_H
+#define TIMER_SERVICE_H
+
+#include "stdincludes.h"
+#include <functional>
+
+//runs callbacks when their deadline expires, using a single thread for all timers. Pending timers are kept in a binary min-heap ordered by deadline; each timer records its position in the heap, so that a deadline that is extended or rescheduled is moved in place and the heap never holds more entries than there are pending timers
+class TimerService {
+public:
+	using Clock=std::chrono::steady_clock;
+	using TimerId=std::uint64_t;
+private:
+	struct Timer {
+		TimerId id;
+		Clock::time_point deadline;
+		std::function<void()> callback;
+		std::size_t heap_index;
+	};
+	mutex mtx;
+	condition_variable cv;
+	map<TimerId,Timer> timers;	//timers that have neither expired nor been canceled; elements of a map are not moved, so the heap can point to them
+	vector<Timer*> heap;	//heap[0] has the earliest deadline, and each element has a deadline not earlier than its parent, heap[(i-1)/2]
+	TimerId last_id=0;
+	optional<TimerId> running;	//timer whose callback is being run
+	bool stopping=false;
+	thread timer_thread{&TimerService::loop,this};
+
+	void place(Timer* timer, std::size_t index) {
+		heap[index]=timer;
+		timer->heap_index=index;
+	}
+	void sift_up(std::size_t index) {
+		auto timer=heap[index];
+		while (index>0 && timer->deadline<heap[(index-1)/2]->deadline) {
+			place(heap[(index-1)/2],index);
+			index=(index-1)/2;
+		}
+		place(timer,index);
+	}
+	void sift_down(std::size_t index) {
+		auto timer=heap[index];
+		while (true) {
+			auto child=2*index+1;
+			if (child>=heap.size()) break;
+			if (child+1<heap.size() && heap[child+1]->deadline<heap[child]->deadline) ++child;
+			if (!(heap[child]->deadline<timer->deadline)) break;
+			place(heap[child],index);
+			index=child;
+		}
+		place(timer,index);
+	}
+	//restore the heap order after the deadline of the timer has changed
+	void update(Timer& timer) {
+		sift_up(timer.heap_index);
+		sift_down(timer.heap_index);
+	}
+	void push(Timer& timer) {
+		heap.push_back(&timer);
+		timer.heap_index=heap.size()-1;
+		sift_up(timer.heap_index);
+	}
+	void remove_from_heap(Timer& timer) {
+		auto index=timer.heap_index;
+		auto last=heap.back();
+		heap.pop_back();
+		if (last!=&timer) {
+			place(last,index);
+			update(*last);
+		}
+	}
+	void loop() {
+		unique_lock<mutex> lock{mtx};
+		while (!stopping) {
+			if (heap.empty()) {
+				cv.wait(lock);
+				continue;
+			}
+			auto& timer=*heap.front();
+			if (Clock::now()<timer.deadline) cv.wait_until(lock,timer.deadline);
+			else {
+				auto id=timer.id;
+				auto callback=std::move(timer.callback);
+				remove_from_heap(timer);
+				timers.erase(id);
+				running=id;
+				lock.unlock();
+				callback();
+				lock.lock();
+				running.reset();
+				cv.notify_all();
+			}
+		}
+	}
+public:
+	TimerService()=default;
+	TimerService(const TimerService&)=delete;
+	~TimerService() {
+		{
+			unique_lock<mutex> lock{mtx};
+			stopping=true;
+		}
+		cv.notify_all();
+		timer_thread.join();
+	}
+	//run callback on the timer thread after the given time
+	TimerId schedule(Clock::duration delay, std::function<void()> callback) {
+		unique_lock<mutex> lock{mtx};
+		++last_id;
+		auto& timer=timers.emplace(last_id,Timer{last_id,Clock::now()+delay,std::move(callback),0}).first->second;
+		push(timer);
+		cv.notify_all();
+		return last_id;
+	}
+	//postpone the deadline of a timer by the given time; return false if the timer has already expired or been canceled
+	bool extend(TimerId id, Clock::duration extra_time) {
+		unique_lock<mutex> lock{mtx};
+		auto it=timers.find(id);
+		if (it==timers.end()) return false;
+		it->second.deadline+=extra_time;
+		update(it->second);
+		return true;
+	}
+	//move the deadline of a timer to the given time from now; return false if the timer has already expired or been canceled
+	bool reschedule(TimerId id, Clock::duration delay) {
+		unique_lock<mutex> lock{mtx};
+		auto it=timers.find(id);
+		if (it==timers.end()) return false;
+		it->second.deadline=Clock::now()+delay;
+		update(it->second);
+		cv.notify_all();	//the new deadline may be earlier
+		return true;
+	}
+	//cancel a timer, waiting for its callback to return if it is running; return false if the callback has been run
+	bool cancel(TimerId id) {
+		unique_lock<mutex> lock{mtx};
+		auto it=timers.find(id);
+		if (it!=timers.end()) {
+			remove_from_heap(it->second);
+			timers.erase(it);
+			cv.notify_all();
+			return true;
+		}
+		cv.wait(lock,[this,id] () {return running!=id;});
+		return false;
+	}
+};
+
+#endif
@@ -1,17 +1,18 @@
 #ifndef UI_H
 #define UI_H
 #include "stdincludes.h"
+#include "processusage.h"
 
 class Computation;
 
 class ThreadUIHandle  {
 public:
-	virtual void computations_added(int assigned_computations, megabytes memory_limit, std::chrono::duration<int> timeout) =0;
+	virtual void computations_added(int assigned_computations, megabytes memory_limit, std::chrono::seconds timeout) =0;
 	virtual void thread_started(megabytes memory) =0;
 	virtual void thread_stopped(megabytes memory) =0;
 	virtual	void thread_terminated() =0;
-	virtual void bad_computation(const Computation& computation, megabytes memory_limit, std::chrono::duration<int> timeout)  =0;	
-	virtual	void finished_computations(int no_computations, megabytes memory) =0;
+	virtual void bad_computation(const Computation& computation, megabytes memory_limit, std::chrono::seconds timeout, const ProcessUsage& usage)  =0;	
+	virtual	void finished_computations(int no_computations, megabytes memory, const ProcessUsage& usage) =0;
 	virtual void unpacking_computations()=0;		
 	virtual void unpacked_computations(int unpacked) =0;
 	virtual void removed_computations_in_db(int eliminated) =0;
@@ -28,8 +29,18 @@ public:
 };
 
 
+struct UnpackingStatistics {
+	int batches=0;	//number of times the unpacking thread was woken up to unpack computations
+	std::chrono::milliseconds time_unpacking{0};	//total time spent unpacking computations
+	std::chrono::milliseconds time_waited_by_workers{0};	//total time spent by workers waiting for computations to be unpacked
+	int workers_waiting=0;	//number of workers currently waiting for computations
+	int completed=0;	//number of computations known to be completed, which are kept in memory
+	megabytes completed_memory=0;	//estimated memory taken by the completed computations
+};
+
 struct MemoryUse {
 	megabytes limit, base_memory_limit, allocated, free;
+	megabytes peak;	//largest resident set size measured for a Magma process
 };
 
 class UserInterface {
@@ -42,6 +53,8 @@ public:
 	virtual void print_computation(const Computation& computation) =0;
 	virtual void update_bad(const vector<pair<megabytes,int>>& memory_limits)=0;
 	virtual void display_memory_limit(MemoryUse memory)=0;
+	virtual void update_unpacking_statistics(const UnpackingStatistics& statistics)=0;
+	virtual void discarded_output(const string& line, const string& reason)=0;	//a line of output of a work script could not be stored
 	virtual string get_filename(const string& text) =0;	
 	virtual int get_number(const string& text) =0;	
 	virtual void attach_controller(Controller* controller=nullptr)=0;
@@ -53,12 +66,12 @@ public:
 
 class ThreadNoUIHandle : public ThreadUIHandle {
 public:
-	void computations_added(int assigned_computations, megabytes memory_limit, std::chrono::duration<int> )  {}
+	void computations_added(int assigned_computations, megabytes memory_limit, std::chrono::seconds )  {}
 	void thread_started(megabytes memory)  {}
 	void thread_stopped(megabytes memory)  {}
 	void thread_terminated() {};
-	void bad_computation(const Computation& computation, megabytes memory_limit, std::chrono::duration<int> )  {}
-	void finished_computations(int no_computations, megabytes memory) {}
+	void bad_computation(const Computation& computation, megabytes memory_limit, std::chrono::seconds, const ProcessUsage&)  {}
+	void finished_computations(int no_computations, megabytes memory, const ProcessUsage&) {}
 	void unpacking_computations() override {}
 	void unpacked_computations(int unpacked) override {}
 	void removed_computations_in_db(int eliminated) override {}
@@ -75,6 +88,8 @@ public:
 	void print_computation(const Computation& computation) override {}
 	void update_bad(const vector<pair<megabytes,int>>& memory_limits) override {}
 	void display_memory_limit(MemoryUse memory) override {}
+	void update_unpacking_statistics(const UnpackingStatistics&) override {}
+	void discarded_output(const string&, const string&) override {}
 	string get_filename(const string& text) override {return {};}
 	int get_number(const string& text) override {return 0;}
 	void attach_controller(Controller* controller=nullptr) override {}
@@ -3,79 +3,166 @@
 #include "memorymanager.h"
 #include "ui.h"
 
-constexpr class large_tag_t {} large_tag;
-
-class WorkerThread {
+//runs batches of computations in Magma processes, one at a time, with the memory limit assigned by the MemoryManager, where workers are called threads.
+//A worker has no thread of its own: its batches are launched by the Scheduler, and the completion of each batch is handled on the reactor thread, which then hands the worker back to the Scheduler
+class Worker {
 	int process_id;
 	string process_id_as_string;
 	unique_ptr<ThreadUIHandle> ui_handle;
-	thread thread_;
-	AssignedComputations computations_to_do;	
+	AssignedComputations computations_to_do;
+	megabytes memory_limit=0;	//0 if the worker is suspended, waiting for memory
+	bool large;	//set for the worker that starts with all the memory left
+	bool started=false;	//set once the worker has asked for memory
+	std::function<void(Worker&)> on_batch_over;
 
-	enum class LoopExitCondition {REDUCE_MEMORY_LIMIT, RAISE_MEMORY_LIMIT};
-	
-	void main_loop(megabytes memory_limit) {
-		while (memory_limit) {
-			ui_handle->thread_started(memory_limit);
-			auto loop_exit_condition=loop_compute(memory_limit);	
-			ui_handle->thread_stopped(memory_limit);
-			memory_limit= MemoryManager::singleton().resize(memory_limit);
+	//ask the MemoryManager for memory; return nullopt if the worker should wait, and 0 if it should terminate
+	optional<megabytes> allocate() {
+		if (started) return MemoryManager::singleton().resume();
+		started=true;
+		return large? MemoryManager::singleton().start_large_thread() : MemoryManager::singleton().start();
+	}
+	void release() {
+		ui_handle->thread_stopped(memory_limit);
+		MemoryManager::singleton().release(memory_limit);
+		memory_limit=0;
+	}
+	//called on the reactor thread when a batch is over
+	void batch_completed(BatchOutcome&& outcome, int no_computations, const TimeLimit& time_limit) {
+		computations_to_do=std::move(outcome.not_completed);
+		MemoryManager::singleton().record_usage(outcome.usage);
+		if (outcome.culprit) {
+			auto& bad=outcome.culprit.value();
+			ui_handle->bad_computation(bad,memory_limit,ComputationRunner::singleton().process_timeout(time_limit),outcome.usage);
+			//a computation that ran out of memory is only retried with a limit above the memory it was seen to use, which may exceed its limit if the work script does not enforce it
+			auto failed_at=max(memory_limit,megabytes(outcome.usage.max_rss_kb/1024));
+			ComputationRunner::singleton().mark_as_bad(bad,failed_at,outcome.usage.failure_cause(),time_limit);
+			computations_to_do.erase(bad);
 		}
-		ui_handle->thread_terminated();
+		else ui_handle->finished_computations(no_computations-computations_to_do.size(),memory_limit,outcome.usage);
+		if (ComputationRunner::singleton().large_thread(memory_limit)) release();
+		on_batch_over(*this);
 	}
+	Worker(const Worker&) =delete;
+	Worker(Worker&&) =delete;
+public:
+	enum class State {RUNNING, SUSPENDED, TERMINATED};
 
-	LoopExitCondition loop_compute(megabytes memory_limit) {
-		while (true) {
-			ComputationRunner::singleton().add_computations_to_do(computations_to_do,memory_limit,*ui_handle);
-			if (computations_to_do.empty()) return LoopExitCondition::RAISE_MEMORY_LIMIT;
-			int no_computations=computations_to_do.size();
-			computations_to_do=ComputationRunner::singleton().compute(process_id_as_string,computations_to_do,memory_limit);
+	Worker(UserInterface* ui, std::function<void(Worker&)> on_batch_over, bool large=false) :
+		process_id{ComputationRunner::singleton().assign_id()},
+		process_id_as_string{to_string(process_id)},
+		ui_handle{ui->make_thread_handle(process_id)},
+		large{large},
+		on_batch_over{std::move(on_batch_over)}
+	{
+		MemoryManager::singleton().add_thread();
+	}
+	//launch the next batch, obtaining memory first if the worker has none; a worker that finds no computations to do with its memory limit releases it and asks for a new one once. Called by the Scheduler; the worker is handed back to it by on_batch_over once the batch is over
+	State step() {
+		for (bool released=false;;released=true) {
+			if (!memory_limit) {
+				auto memory=allocate();
+				if (!memory) return State::SUSPENDED;
+				if (!memory.value()) {
+					ComputationRunner::singleton().release_process(process_id_as_string);
+					ui_handle->thread_terminated();
+					return State::TERMINATED;
+				}
+				memory_limit=memory.value();
+				ui_handle->thread_started(memory_limit);
+			}
+			auto time_limit=ComputationRunner::singleton().add_computations_to_do(computations_to_do,memory_limit,*ui_handle);
 			if (!computations_to_do.empty()) {
-				auto bad=computations_to_do.begin();
-				ui_handle->bad_computation(*bad,memory_limit,ComputationRunner::singleton().process_timeout(memory_limit));
-				ComputationRunner::singleton().mark_as_bad(*bad,memory_limit);
-				computations_to_do.erase(bad);
+				int no_computations=computations_to_do.size();
+				//the batch may be over before compute returns, so the worker must not be accessed after calling it
+				ComputationRunner::singleton().compute(process_id_as_string,computations_to_do,memory_limit,time_limit,[this,no_computations,time_limit] (BatchOutcome&& outcome) {
+					batch_completed(std::move(outcome),no_computations,time_limit);
+				});
+				return State::RUNNING;
 			}
-			else ui_handle->finished_computations(no_computations-computations_to_do.size(),memory_limit);
-			if (ComputationRunner::singleton().large_thread(memory_limit)) return LoopExitCondition::REDUCE_MEMORY_LIMIT;
-		}	
+			release();
+			if (released) return State::SUSPENDED;
+		}
 	}
-	WorkerThread(const WorkerThread&) =delete;
-	WorkerThread(WorkerThread&&) =delete;
-public:
-	WorkerThread(UserInterface* ui) : 
-		process_id{ComputationRunner::singleton().assign_id()}, 
-		process_id_as_string{to_string(process_id)},
-		ui_handle{ui->make_thread_handle(process_id)},
-		thread_{&WorkerThread::main_loop,this,MemoryManager::singleton().start()}
-	{}
-	WorkerThread(UserInterface* ui,large_tag_t) : 
-		process_id{ComputationRunner::singleton().assign_id()}, 
-		process_id_as_string{to_string(process_id)},
-		ui_handle{ui->make_thread_handle(process_id)},
-		thread_{&WorkerThread::main_loop,this,MemoryManager::singleton().start_large_thread()}	
-	{}
-	void join() {thread_.join();}
 };
 
-class WorkerThreads {
-	vector<unique_ptr<WorkerThread>> threads;
+//launches the batches of all workers on a single thread. While its batch runs, a worker is only referred to by the callbacks of the reactor, so there is no thread waiting for each running process
+class Scheduler {
+	vector<unique_ptr<Worker>> workers;
+	mutex mtx;
+	condition_variable cv;
+	vector<Worker*> ready;	//workers whose batch is over, or that have not started yet
+	bool memory_available=false;	//set when the memory limits are changed
+	thread scheduler_thread;
+
+	void batch_over(Worker& worker) {
+		{
+			unique_lock<mutex> lock{mtx};
+			ready.push_back(&worker);
+		}
+		cv.notify_one();
+	}
+	void notify_memory_available() {
+		{
+			unique_lock<mutex> lock{mtx};
+			memory_available=true;
+		}
+		cv.notify_one();
+	}
+	//suspended workers are resumed whenever a batch is over or the memory limits are changed, and in any case every 10 seconds
+	void loop() {
+		vector<Worker*> suspended;
+		int active=workers.size();
+		bool retry=false;
+		while (active) {
+			vector<Worker*> idle;
+			{
+				unique_lock<mutex> lock{mtx};
+				if (!retry) cv.wait_for(lock,std::chrono::seconds(10),[this] () {return !ready.empty() || memory_available;});
+				idle.swap(ready);
+				memory_available=false;
+			}
+			idle.insert(idle.end(),suspended.begin(),suspended.end());	//workers that hold memory come first
+			suspended.clear();
+			retry=false;
+			for (auto worker : idle)
+				switch (worker->step()) {
+					case Worker::State::SUSPENDED:
+						suspended.push_back(worker);
+						break;
+					case Worker::State::TERMINATED:
+						--active;
+						retry=true;	//the computation is finished, so the suspended workers should terminate as well
+						break;
+					default:
+						break;
+				}
+			retry=retry && !suspended.empty();
+		}
+	}
 public:
-	WorkerThreads(const Parameters& parameters, UserInterface* ui) {	 
+	Scheduler(const Parameters& parameters, UserInterface* ui) {
 		try {
 			ComputationRunner::singleton().init(parameters);
-			ui->display_memory_limit(MemoryManager::singleton().set_memory_limit(parameters.computation_parameters.total_memory_limit,parameters.computation_parameters.base_memory_limit));
+			ui->display_memory_limit(MemoryManager::singleton().set_memory_limit(parameters.computation_parameters.total_memory_limit,parameters.computation_parameters.base_memory_limit,make_admission_policy(parameters.computation_parameters.admission_policy)));
 		}
 		catch (Exception& e) {
 			cout<<e.what()<<endl;
 			throw;
 		}
+		ComputationRunner::singleton().start_unpacking_thread(ui->make_thread_handle(0));
+		auto on_batch_over=[this] (Worker& worker) {batch_over(worker);};
 		for (int i=1;i<parameters.computation_parameters.nthreads;++i)
-			threads.push_back(make_unique<WorkerThread>(ui));
-		threads.push_back(make_unique<WorkerThread>(ui,large_tag));
+			workers.push_back(make_unique<Worker>(ui,on_batch_over));
+		workers.push_back(make_unique<Worker>(ui,on_batch_over,true));
+		for (auto& worker : workers) ready.push_back(worker.get());
+		MemoryManager::singleton().on_memory_available([this] () {notify_memory_available();});
+		scheduler_thread=thread{&Scheduler::loop,this};
 	}
 	void join() {
-		for (auto& t: threads) t->join();
+		scheduler_thread.join();
+		MemoryManager::singleton().on_memory_available({});
+		ComputationRunner::singleton().stop_unpacking_thread();
+		ComputationRunner::singleton().close_output();
 	}
 };
 
@@ -0,0 +1,165 @@
+/***************************************************************************
+	Copyright (C) 2021 by Diego Conti, diego.conti@unimib.it
+
+	This file is part of hliðskjálf.
+	Hliðskjálf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef WORK_OUTPUT_INDEX_H
+#define WORK_OUTPUT_INDEX_H
+
+#include "synchronizedcomputations.h"
+#include "segment.h"
+
+//Index of the computations completed in the work output directory, stored on disk so that each run only parses the bytes appended to the work output files since the previous run.
+//The index file is a journal. Each line is either the input of a completed computation, or a record @size;offset;filename stating that filename had the given size and was parsed up to offset; the computations listed before a record were found in the corresponding file.
+//Since a record is appended after each write to the work output, the journal is compacted at initialization when it has more than JOURNAL_COMPACTION_FACTOR lines per computation or file it describes
+class WorkOutputIndex {
+	static constexpr int JOURNAL_COMPACTION_FACTOR=2;
+	struct ParsedFile {
+		std::uintmax_t size=0;
+		std::uintmax_t offset=0;
+	};
+	fs::path output_dir;
+	string index_file;
+	const CSVSchema& schema;
+	map<string,ParsedFile> parsed_files;
+	ofstream journal;
+	std::uintmax_t journal_lines=0;
+	mutable mutex mtx;
+
+	Computation computation_from_key(const string& key) const {
+		CSVLine csv_line{key};
+		vector<string> secondary_inputs;
+		for (int i=1;i<csv_line.size();++i) secondary_inputs.push_back(csv_line[i]);
+		secondary_inputs.resize(schema.no_secondary_input_columns());
+		return {stoi(csv_line[0]),move(secondary_inputs)};
+	}
+	void add_record(const string& record) {
+		auto first_separator=record.find(';'), second_separator=record.find(';',first_separator+1);
+		if (second_separator==string::npos) throw CSVException("invalid index record",record);
+		auto& parsed=parsed_files[record.substr(second_separator+1)];
+		parsed.size=std::stoull(record.substr(1,first_separator-1));
+		parsed.offset=std::stoull(record.substr(first_separator+1,second_separator-first_separator-1));
+	}
+	void write_key(const string& key) {
+		journal<<key<<"\n";
+		++journal_lines;
+	}
+	void write_record(const string& filename, const ParsedFile& parsed) {
+		journal<<"@"<<parsed.size<<";"<<parsed.offset<<";"<<filename<<"\n";
+		journal.flush();
+		++journal_lines;
+	}
+	//rewrite the journal with one line for each computation and one record for each file; the new journal replaces the old one atomically
+	void compact(const ComputationSet& completed) {
+		journal.close();
+		auto compacted=index_file+".compacted";
+		journal.open(compacted,std::ofstream::trunc);
+		journal_lines=0;
+		for (auto& computation : completed) write_key(computation.to_string());
+		for (auto& p : parsed_files) write_record(p.first,p.second);
+		journal.close();
+		if (!journal) throw FileException(compacted,"cannot write index");
+		fs::rename(compacted,index_file);
+		journal.open(index_file,std::ofstream::app);
+	}
+	//read the index file; return false if it is corrupted or it does not reflect the contents of the work output directory
+	bool load(ComputationSet& completed) {
+		ifstream s{index_file};
+		vector<Computation> pending;
+		string line;
+		try {
+			while (std::getline(s,line)) {
+				++journal_lines;
+				if (line.empty()) continue;
+				else if (line[0]!='@') pending.push_back(computation_from_key(line));
+				else {
+					add_record(line);
+					completed.insert(pending.begin(),pending.end());
+					pending.clear();
+				}
+			}
+		}
+		catch (...) {
+			return false;
+		}
+		for (auto& p : parsed_files) {
+			auto path=output_dir/p.first;
+			if (!fs::is_regular_file(path) || fs::file_size(path)<p.second.offset) return false;
+		}
+		return true;
+	}
+	//parse the complete lines appended to a work output file after the last scan; the footer of a segment that has not been scanned before is used instead of the lines, if present
+	template<typename Completed> void update_file(const fs::path& path, Completed& completed) {
+		auto filename=path.filename().native();
+		auto size=fs::file_size(path);
+		auto& parsed=parsed_files[filename];
+		if (size==parsed.size) return;
+		if (size<parsed.offset) parsed.offset=0;
+		if (parsed.offset==0) 
+			if (auto keys=read_segment_footer(path.native())) {
+				for (auto& key : keys.value()) {
+					write_key(key);
+					completed.insert(computation_from_key(key));
+				}
+				parsed.size=parsed.offset=size;
+				write_record(filename,parsed);
+				return;
+			}
+		ifstream f{path.native()};
+		f.seekg(parsed.offset);
+		string line;
+		while (std::getline(f,line) && !f.eof()) {
+			parsed.offset=f.tellg();
+			if (line.empty() || is_segment_metadata(line)) continue;
+			auto computation=CSVReader::extract_computation(CSVLine{line},schema);
+			write_key(computation.to_string());
+			completed.insert(std::move(computation));
+		}
+		parsed.size=size;
+		write_record(filename,parsed);
+	}
+public:
+	WorkOutputIndex(const string& output_dir, const string& index_file, const CSVSchema& schema) : output_dir{output_dir}, index_file{index_file}, schema{schema} {}
+	//read the index and the data appended to the work output directory since it was last updated; to be called once, at initialization
+	void load(CompletedComputations& completed_computations) {
+		unique_lock<mutex> lock{mtx};
+		ComputationSet completed;
+		if (load(completed)) journal.open(index_file,std::ofstream::app);
+		else {
+			parsed_files.clear();
+			completed.clear();
+			journal_lines=0;
+			journal.open(index_file,std::ofstream::trunc);
+		}
+		if (!journal) throw FileException(index_file,"cannot write index");
+		for (auto& x : fs::directory_iterator(output_dir))
+			if (fs::is_regular_file(x)) update_file(x.path(),completed);
+		if (journal_lines>JOURNAL_COMPACTION_FACTOR*(completed.size()+parsed_files.size())) compact(completed);
+		completed_computations.insert(completed);
+	}
+	//to be called after appending the output of the given computations, or a footer, to output_file
+	template<typename Computations> void record(const string& output_file, const Computations& computations) {
+		unique_lock<mutex> lock{mtx};
+		auto path=fs::path{output_file};
+		auto& parsed=parsed_files[path.filename().native()];
+		for (auto& computation : computations) 
+			write_key(computation.to_string());
+		parsed.size=parsed.offset=fs::file_size(path);
+		write_record(path.filename().native(),parsed);
+	}
+};
+
+#endif
@@ -22,6 +22,7 @@
 #include "db.h"
 #include "csvschema.h"
 #include "csvreader.h"
+#include "segment.h"
 
 using namespace std;
 
@@ -52,6 +53,7 @@ public:
 	OmittedEntries update_db(const CSV& csv, const CSVSchema& schema) {
 		OmittedEntries omitted;
 		for (auto& line : csv) {
+			if (is_segment_metadata(line)) continue;
 			auto omit=CSVReader::omit_reason_or_null(line,schema);
 			if (omit) omitted.increment(omit);
 			else CSVReader::insert_entry(line,schema,db);
@@ -75,6 +77,38 @@ void update_db(const fs::path& work_output_path, Database& db,const CSVSchema& s
 	os<<omitted.to_string();
 }
 
+//rewrite the work output files that are not segments with a footer into segments, and remove them
+void convert_to_segments(const fs::path& work_output_path, const CSVSchema& schema, const string& extension, std::uintmax_t segment_size, ostream& os) {
+	vector<fs::path> to_convert;
+	for (auto& file : fs::directory_iterator(work_output_path))
+		if (fs::is_regular_file(file) && !read_segment_footer(file.path().native())) to_convert.push_back(file.path());
+	unique_ptr<SegmentWriter> segment;
+	int segments=0;
+	for (auto& file : to_convert) {
+		if (!segment) {
+			segment=make_unique<SegmentWriter>(new_segment_name(work_output_path,extension));
+			++segments;
+		}
+		for (auto& line : CSV::from_file(file.native(),CSV::balance_braces))
+			if (!is_segment_metadata(line)) segment->add(line.to_string(),CSVReader::extract_computation(line,schema).to_string());
+		segment->write(false);
+		if (segment->size()>=segment_size) {
+			segment->close(true);
+			segment.reset();
+		}
+	}
+	if (segment) segment->close(true);
+	for (auto& file : to_convert) fs::remove(file);
+	os<<"Converted "<<to_convert.size()<<" files into "<<segments<<" segments"<<endl;
+}
+
+void read_schema_and_convert_to_segments(const string& schema_path, const string& work_output_path, const string& extension, std::uintmax_t segment_size, ostream& output) {
+    	pt::ptree tree;
+    	pt::read_info(schema_path,tree);
+    	auto schema=CSVSchema{tree};
+		convert_to_segments(work_output_path,schema,extension,segment_size,output);
+}
+
 void read_schema_and_update_db(const string& schema_path, const string& db_path, const string& work_output_path, ostream& output) {	
     	pt::ptree tree;
     	pt::read_info(schema_path,tree);
@@ -92,12 +126,15 @@ int main(int argv, char** argc) {
     ("workoutput", po::value<string>(), "directory containing the output of the work script")
     ("db", po::value<string>()->default_value("db"), "directory containing the database")
     ("schema", po::value<string>(), "file containing the description of the CSV schema")
-	("output", po::value<string>()->default_value(""), "if specified, filename to receive output");
+	("output", po::value<string>()->default_value(""), "if specified, filename to receive output")
+	("segments", "instead of updating the database, convert the work output files into segments, as written by hliðskjálf")
+	("segment-size", po::value<int>()->default_value(256), "size in MB of the segments created by --segments")
+	("extension", po::value<string>()->default_value(".work"), "extension of the segments created by --segments");
 	po::variables_map vm;
 	po::store(po::parse_command_line(argv, argc, desc), vm);
 	po::notify(vm);    	
 
-	if (vm.count("help") || !vm.count("workoutput") || !vm.count("schema")) {
+	if (vm.count("help") || !vm.count("workoutput") || !vm.count("schema") || vm["segment-size"].as<int>()<=0) {
 		cout<<desc<<endl;
 		return 1;
 	}
@@ -108,12 +145,13 @@ int main(int argv, char** argc) {
 	string output_file=vm["output"].as<string>();
 
 	try {
-		if (output_file.empty())
-			read_schema_and_update_db(schema_path,db_path,work_output_path,cout);
-		else {
-			ofstream output{output_file,std::ofstream::trunc};		
+		ofstream output_stream;
+		if (!output_file.empty()) output_stream.open(output_file,std::ofstream::trunc);
+		ostream& output=output_file.empty()? cout : output_stream;
+		if (vm.count("segments"))
+			read_schema_and_convert_to_segments(schema_path,work_output_path,vm["extension"].as<string>(),static_cast<std::uintmax_t>(vm["segment-size"].as<int>())*1024*1024,output);
+		else
 			read_schema_and_update_db(schema_path,db_path,work_output_path,output);
-		}
 	}
 	catch (Exception& e) {
 		cerr<<e.what()<<endl;
@@ -3,18 +3,27 @@ function(cat IN_FILE OUT_FILE)
   file(APPEND ${OUT_FILE} "${CONTENTS}")
 endfunction()
 
+if (NOT DEFINED TEST_NAME)
+  set (TEST_NAME ${WORKSCRIPT})
+endif()
+
 set (OUTPUT_DIR ${PROJECT_BINARY_DIR}/output)
+set (SIDE_FILES ${OUTPUT_DIR}.costs ${OUTPUT_DIR}.index ${OUTPUT_DIR}.batches ${OUTPUT_DIR}.valhalla)
 file(REMOVE_RECURSE ${OUTPUT_DIR})
+#the files written alongside the work output would carry state over from a previous test, e.g. failures recorded in the costs file would be skipped rather than repeated
+file(REMOVE ${SIDE_FILES})
 separate_arguments(FLAGS UNIX_COMMAND ${HLIDSKJALF_FLAGS})
 execute_process(COMMAND ${CMAKE_TOP_BINARY_DIR}/hlidskjalf --script ${PROJECT_SOURCE_DIR}/script/${WORKSCRIPT}.m --workoutput ${OUTPUT_DIR} --computations ${PROJECT_SOURCE_DIR}/computations/test.comp  --schema ${PROJECT_SOURCE_DIR}/script/testschema.info --workload 1 --stdio ${FLAGS} WORKING_DIRECTORY ${CMAKE_TOP_BINARY_DIR})
 
-set (UNSORTED_OUTPUT ${PROJECT_BINARY_DIR}/${WORKSCRIPT}.unsorted)
+set (UNSORTED_OUTPUT ${PROJECT_BINARY_DIR}/${TEST_NAME}.unsorted)
 file(WRITE ${UNSORTED_OUTPUT} "")
 file(GLOB output_files LIST_DIRECTORIES false "${OUTPUT_DIR}/*")
 foreach(out_file ${output_files})	
     cat(${out_file} ${UNSORTED_OUTPUT})
 endforeach()
 
-execute_process(COMMAND sort ${UNSORTED_OUTPUT} -o ${PROJECT_BINARY_DIR}/${WORKSCRIPT}.test)
+#lines starting with # belong to the footers of the segments
+execute_process(COMMAND grep -v "^#" ${UNSORTED_OUTPUT} COMMAND sort -o ${PROJECT_BINARY_DIR}/${TEST_NAME}.test)
 file(REMOVE ${UNSORTED_OUTPUT})
-file(REMOVE_RECURSE ${OUTPUT_DIR})
\ No newline at end of file
+file(REMOVE_RECURSE ${OUTPUT_DIR})
+file(REMOVE ${SIDE_FILES})
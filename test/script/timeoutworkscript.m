@@ -15,17 +15,17 @@ end procedure;
 
 ComputeAndWriteToStdout:=procedure(fileName)
 	file:=Open(fileName,"r");
-	line:=Gets(file);
+	line:=NextComputation(file);
 	while not IsEof(line) do
 		d,X,Y:=ReadLine(line);
 		starttime:=Realtime();
 		while Realtime(starttime) lt d do;
 		end while;
 		WriteLine(d,X,Y,Sprint(d) cat X cat Y);
-		line:=Gets(file);
+		line:=NextComputation(file);
 	end while;
 end procedure;
 
 
-ComputeAndWriteToStdout(dataFile);
+ProcessDataFiles(ComputeAndWriteToStdout);
 quit;
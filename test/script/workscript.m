@@ -14,13 +14,13 @@ end procedure;
 
 ComputeAndWriteToStdout:=procedure(fileName)
 	file:=Open(fileName,"r");
-	line:=Gets(file);
+	line:=NextComputation(file);
 	while not IsEof(line) do
 		d,X,Y:=ReadLine(line);
 		WriteLine(d,X,Y,Sprint(d) cat X cat Y);
-		line:=Gets(file);
+		line:=NextComputation(file);
 	end while;
 end procedure;
 
-ComputeAndWriteToStdout(dataFile);
+ProcessDataFiles(ComputeAndWriteToStdout);
 quit;
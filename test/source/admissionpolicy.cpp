@@ -0,0 +1,48 @@
+#include "admissionpolicy.h"
+#include "output.h"
+
+using namespace std;
+
+void print_request(OutputStream& os, const string& description, const AdmissionState& state) {
+	for (auto& name : ADMISSION_POLICIES) {
+		auto request=make_admission_policy(name)->to_request(state);
+		os<<name<<", "<<description<<": ";
+		if (request) os<<request.value()<<" MB"<<endl;
+		else os<<"wait"<<endl;
+	}
+}
+
+int main(int argv, char** argc) {
+	OutputStream os;
+	AdmissionState state;
+	state.limit=4096;
+	state.base_memory_limit=128;
+	state.suspended_threads=10;
+	state.pending={{0,1000}};
+	print_request(os,"new computations only",state);
+	state.allocated=1024;
+	state.running={128,128,256,512};
+	state.pending={{0,1000},{256,3},{1024,1}};
+	print_request(os,"some failed computations",state);
+	state.running.push_back(2048);
+	state.allocated+=2048;
+	print_request(os,"largest computation running",state);
+	state.running={256,256,512,512,2048};
+	state.allocated=3584;
+	state.pending={{256,3},{1024,1}};
+	state.lowest=256;
+	print_request(os,"only failed computations",state);
+	state.allocated=4000;
+	print_request(os,"no memory left",state);
+	try {
+		make_admission_policy("unknown");
+	}
+	catch (const Exception& e) {
+		os<<e.what()<<endl;
+	}
+	if (argv==2) 
+		os.flush_to_file(argc[1]);
+	else
+		os.flush_to_cout();
+	return 0;
+}
@@ -0,0 +1,34 @@
+#include "batchsizer.h"
+#include "output.h"
+
+using namespace std;
+using std::chrono::milliseconds;
+
+int main(int argv, char** argc) {
+	OutputStream os;
+	BatchSizer sizer{std::chrono::seconds{60},100};
+	os<<"before any batch: "<<sizer.size(128)<<endl;
+	sizer.record(128,100,false,milliseconds{10000});
+	os<<"after 100 computations in 10s: "<<sizer.size(128)<<endl;
+	sizer.record(128,600,false,milliseconds{30000});
+	os<<"after 600 computations in 30s: "<<sizer.size(128)<<endl;
+	os<<"closest memory limits: "<<sizer.size(100)<<" "<<sizer.size(1024)<<endl;
+	sizer.record(512,0,true,milliseconds{120000});
+	os<<"after a failure in 120s with 512MB: "<<sizer.size(512)<<", with 128MB: "<<sizer.size(128)<<endl;
+	for (int i=0;i<3;++i) sizer.record(256,9,true,milliseconds{3000});
+	os<<"after three batches with 10% failures: "<<sizer.size(256)<<endl;
+	for (int i=0;i<3;++i) sizer.record(256,0,true,milliseconds{1000});
+	os<<"after three failures: "<<sizer.size(256)<<endl;
+	auto print_timeouts=[&os] (const string& description, BatchTimeouts timeouts) {
+		os<<description<<": progress "<<timeouts.progress.count()<<"s, total "<<timeouts.total.count()<<"s"<<endl;
+	};
+	print_timeouts("100 computations of at most 60s",BatchTimeouts::for_batch(std::chrono::seconds{60},100));
+	print_timeouts("600000 computations of at most an hour",BatchTimeouts::for_batch(std::chrono::hours{1},600000));
+	print_timeouts("the largest batch of computations of at most a year",BatchTimeouts::for_batch(std::chrono::hours{24*365},std::numeric_limits<int>::max()));
+	print_timeouts("no time limit",BatchTimeouts::for_batch(std::chrono::seconds::zero(),std::numeric_limits<int>::max()));
+	if (argv==2) 
+		os.flush_to_file(argc[1]);
+	else
+		os.flush_to_cout();
+	return 0;
+}
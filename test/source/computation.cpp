@@ -14,11 +14,27 @@ int main(int argv, char** argc) {
 		return 1;
 	}
 	ifstream f(argc[2]);
+	int lines=0, matching=0, matching_previous=0;
+	string previous;
 	while (has_data_after_skipping_empty_lines(f)) {
 		auto line = get_line_with_balanced_curly_braces(f);
 		Computation c=CSVReader::extract_computation(line,schema);
 		os<<c.to_string()<<endl;
+		++lines;
+		if (CSVReader::input_matches(line,schema,c.to_string())) ++matching;
+		if (!previous.empty() && previous!=c.to_string() && CSVReader::input_matches(line,schema,previous)) ++matching_previous;
+		previous=c.to_string();
 	}
+	os<<matching<<" of "<<lines<<" lines match their input, "<<matching_previous<<" match a different input"<<endl;
+	vector<string> many_inputs;
+	for (int i=0;i<40;++i) many_inputs.push_back(std::to_string(i));
+	many_inputs[1]="Odin";
+	many_inputs[35]="Thor";
+	Computation many{1,many_inputs};
+	os<<many.to_string()<<endl;
+	many_inputs[35]=std::to_string(StringPool::singleton().intern("Thor"));
+	Computation same_ids{1,many_inputs};
+	os<<"copy "<<(Computation{many}==many? "equal" : "different")<<", integer in place of text "<<(same_ids==many? "equal" : "different")<<endl;
 	if (argv==4) 
 		os.flush_to_file(argc[3]);
 	else
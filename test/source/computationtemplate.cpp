@@ -0,0 +1,52 @@
+#include "synchronizedcomputations.h"
+#include "csvreader.h"
+#include "output.h"
+
+using namespace std;
+
+void print_instances(OutputStream& os, ComputationTemplate&& computation_template) {
+	ComputationTemplateCursor cursor{std::move(computation_template)};
+	os<<cursor.remaining_computations()<<" computations"<<endl;
+	while (!cursor.at_end())
+		os<<cursor.next().to_string()<<endl;
+}
+
+int main(int argv, char** argc) {
+	OutputStream os;
+	if (argv<3) {
+		cerr<<"usage: "<<argc[0]<<" schemafile compfile [outfile]"<<endl;		
+		return 1;
+	}
+	pt::ptree tree;
+	pt::read_info(argc[1],tree);
+	auto schema=CSVSchema(tree);
+	try {
+		ifstream f(argc[2]);
+		while (has_data_after_skipping_empty_lines(f)) {
+			string line;
+			getline(f,line);
+			print_instances(os,CSVReader::extract_computation_template(line,schema));
+		}
+		ComputationTemplate with_two_ranges{5};
+		with_two_ranges.add_range("1..2");
+		with_two_ranges.add_text("x");
+		with_two_ranges.add_range("-1..1");
+		CompletedComputations completed;
+		completed.insert(vector<Computation>{{5,vector<string>{"1","x","0"}},{5,vector<string>{"2","x","-1"}},{5,vector<string>{"2","x","0"}},{5,vector<string>{"2","x","1"}}});
+		ComputationTemplate rest{with_two_ranges};
+		auto first_value=rest.split_first_value(0);
+		for (auto& residual : completed.residual(std::move(first_value)))
+			print_instances(os,std::move(residual));
+		os<<completed.residual(std::move(rest)).size()<<" residual templates"<<endl;
+		print_instances(os,std::move(with_two_ranges));
+	}
+	catch (const Exception& e) {
+		cerr<<e.what()<<endl;
+		return 1;
+	}
+	if (argv==4) 
+		os.flush_to_file(argc[3]);
+	else
+		os.flush_to_cout();
+	return 0;
+}
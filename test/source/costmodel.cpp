@@ -0,0 +1,53 @@
+#include "costmodel.h"
+#include "output.h"
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+using namespace std;
+
+void print_failure_limit(OutputStream& os, const CostModel& cost_model, const Computation& computation) {
+	auto limit=cost_model.failure_limit(computation);
+	os<<computation.to_string()<<": ";
+	if (limit) os<<"fails with "<<limit.value()<<" MB"<<endl;
+	else os<<"no failure known"<<endl;
+}
+
+int main(int argv, char** argc) {
+	OutputStream os;
+	auto filename=(fs::temp_directory_path()/fs::unique_path()).native();
+	{
+		ofstream s{filename};
+		s<<"1;a;2;128;50000;version 1"<<endl;
+		s<<"1;a;2;256;90000;version 1"<<endl;
+		s<<"1;a;3;128;400000;version 2"<<endl;
+		s<<"invalid line"<<endl;
+	}
+	Computation first{1,vector<string>{"a","2"}}, second{1,vector<string>{"a","3"}}, third{2,vector<string>{"b","4"}};
+	{
+		CostModel cost_model{filename,"version 1",2};
+		os<<cost_model.size()<<" computations known to fail"<<endl;
+		print_failure_limit(os,cost_model,first);
+		print_failure_limit(os,cost_model,second);
+		ProcessUsage usage;
+		usage.max_rss_kb=70000;
+		cost_model.record_failure(third,512,usage);
+		print_failure_limit(os,cost_model,third);
+		usage.max_rss_kb=700000;
+		cost_model.record_failure(first,256,usage);
+		print_failure_limit(os,cost_model,first);
+	}
+	CostModel cost_model{filename,"version 1",2};
+	os<<"after reloading, "<<cost_model.size()<<" computations known to fail"<<endl;
+	print_failure_limit(os,cost_model,first);
+	print_failure_limit(os,cost_model,third);
+	CostModel other_version{filename,"version 2",2};
+	os<<"for version 2, "<<other_version.size()<<" computations known to fail"<<endl;
+	print_failure_limit(os,other_version,second);
+	fs::remove(filename);
+	if (argv==2) 
+		os.flush_to_file(argc[1]);
+	else
+		os.flush_to_cout();
+	return 0;
+}
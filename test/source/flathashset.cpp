@@ -0,0 +1,73 @@
+#include "flathashset.h"
+#include "output.h"
+
+using namespace std;
+
+//a poor hash function, to exercise collisions and long probe sequences
+struct CollidingHash {
+	std::size_t operator()(int x) const {return (x%97)*0x9E3779B97F4A7C15ull;}
+};
+
+using TestSet=FlatHashSet<int,CollidingHash>;
+
+bool same_elements(const TestSet& flat, const set<int>& reference) {
+	if (flat.size()!=reference.size()) return false;
+	set<int> elements{flat.begin(),flat.end()};
+	if (elements!=reference) return false;
+	for (auto x: reference) if (!flat.count(x)) return false;
+	return true;
+}
+
+void print_state(OutputStream& os, const string& operation, const TestSet& flat, const set<int>& reference) {
+	os<<operation<<": size "<<flat.size()<<(same_elements(flat,reference)? ", consistent" : ", INCONSISTENT")<<endl;
+}
+
+int main(int argv, char** argc) {
+	OutputStream os;
+	TestSet flat;
+	set<int> reference;
+	unsigned int state=1;
+	auto random=[&state] () {state=state*1103515245+12345; return static_cast<int>((state>>8)%5000);};
+	print_state(os,"empty",flat,reference);
+	for (int i=0;i<3000;++i) {
+		auto x=random();
+		if (flat.insert(x)!=reference.insert(x).second) os<<"insert returned the wrong value for "<<x<<endl;
+	}
+	print_state(os,"insert",flat,reference);
+	for (int i=0;i<2000;++i) {
+		auto x=random();
+		if (flat.erase(x)!=reference.erase(x)) os<<"erase returned the wrong value for "<<x<<endl;
+	}
+	print_state(os,"erase by key",flat,reference);
+	for (int i=0;i<2000;++i) {
+		auto x=random();
+		flat.insert(x);
+		reference.insert(x);
+	}
+	print_state(os,"insert after erase",flat,reference);
+	for (auto i=flat.begin();i!=flat.end();)
+		if (*i%3==0) {
+			reference.erase(*i);
+			i=flat.erase(i);
+		}
+		else ++i;
+	print_state(os,"erase while iterating",flat,reference);
+	TestSet copy=flat;
+	print_state(os,"copy",copy,reference);
+	set<int> taken;
+	while (!flat.empty()) {
+		int size=flat.size();
+		if (flat.take(100,taken)!=min(100,size)) os<<"take returned the wrong value"<<endl;
+	}
+	os<<"take: "<<(taken==reference? "all elements taken" : "WRONG ELEMENTS TAKEN")<<endl;
+	print_state(os,"after take",flat,{});
+	flat=std::move(copy);
+	print_state(os,"move",flat,reference);
+	flat.clear();
+	print_state(os,"clear",flat,{});
+	if (argv==2) 
+		os.flush_to_file(argc[1]);
+	else
+		os.flush_to_cout();
+	return 0;
+}
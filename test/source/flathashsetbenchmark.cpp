@@ -0,0 +1,54 @@
+#include "synchronizedcomputations.h"
+
+using namespace std;
+using std::chrono::steady_clock;
+
+//compare ComputationSet with unordered_set on the access pattern of the pending and assigned computations: insert many, erase by key, extract batches
+using StdComputationSet=unordered_set<Computation,boost::hash<Computation>>;
+
+template<typename Set> void take(int n, Set& from, Set& to) {
+	if constexpr (std::is_same_v<Set,ComputationSet>) from.take(n,to);
+	else {
+		auto i=from.begin(),j=n_th_element_or_end(from.begin(),from.end(),n);
+		to.insert(i,j);
+		from.erase(i,j);
+	}
+}
+
+template<typename Set> void benchmark(const string& name, const vector<Computation>& computations, int batch_size) {
+	auto start=steady_clock::now();
+	auto elapsed=[&start] () {
+		auto now=steady_clock::now();
+		auto result=std::chrono::duration_cast<std::chrono::milliseconds>(now-start).count();
+		start=now;
+		return result;
+	};
+	Set pending;
+	for (auto& computation : computations) pending.insert(computation);
+	cout<<name<<": insert "<<elapsed()<<"ms";
+	for (int i=0;i<computations.size();i+=4) erase(pending,computations[i]);
+	cout<<", erase by key "<<elapsed()<<"ms";
+	int found=0;
+	for (auto& computation : computations) found+=pending.count(computation);
+	cout<<", lookup "<<elapsed()<<"ms";
+	while (!pending.empty()) {
+		Set assigned;
+		take(batch_size,pending,assigned);
+		for (auto& computation : assigned) found-=pending.count(computation);
+	}
+	cout<<", extract batches "<<elapsed()<<"ms";
+	cout<<" ("<<found<<" found)"<<endl;
+}
+
+int main(int argc, char** argv) {
+	int no_computations=argc>1? stoi(argv[1]) : 1000000;
+	int batch_size=argc>2? stoi(argv[2]) : 100;
+	vector<Computation> computations;
+	computations.reserve(no_computations);
+	for (int i=0;i<no_computations;++i)
+		computations.emplace_back(i%1000,vector<string>{std::to_string(i/1000),"x"});
+	cout<<no_computations<<" computations, batches of "<<batch_size<<endl;
+	benchmark<StdComputationSet>("unordered_set",computations,batch_size);
+	benchmark<ComputationSet>("FlatHashSet",computations,batch_size);
+	return 0;
+}
@@ -0,0 +1,56 @@
+#include "intervalset.h"
+#include "output.h"
+
+using namespace std;
+
+const int MIN=std::numeric_limits<int>::min();
+const int MAX=std::numeric_limits<int>::max();
+
+string to_string(const vector<pair<int,int>>& intervals) {
+	string result;
+	for (auto& interval : intervals) result+=" "+std::to_string(interval.first)+".."+std::to_string(interval.second);
+	return result.empty()? " none" : result;
+}
+
+void print(OutputStream& os, const string& description, const IntervalSet& set) {
+	os<<description<<":"<<to_string(vector<pair<int,int>>{set.begin(),set.end()})<<endl;
+}
+
+void print_complement(OutputStream& os, const IntervalSet& set, int min, int max) {
+	os<<"complement in "<<min<<".."<<max<<":"<<to_string(set.complement(min,max))<<endl;
+}
+
+int main(int argv, char** argc) {
+	OutputStream os;
+	IntervalSet set;
+	print_complement(os,set,1,10);
+	for (int x : {5,3,4,10,8}) set.insert(x);
+	print(os,"after inserting 5,3,4,10,8",set);
+	set.insert(9);
+	print(os,"bridging with 9",set);
+	set.insert(4);
+	print(os,"inserting 4 again",set);
+	set.insert(6);
+	print(os,"extending with 6",set);
+	print_complement(os,set,1,12);
+	print_complement(os,set,3,10);
+	print_complement(os,set,4,8);
+	print_complement(os,set,6,7);
+	print_complement(os,set,7,7);
+	print_complement(os,set,11,11);
+	IntervalSet extremes;
+	for (int x : {MAX,MIN,MAX-1,MIN+1,MAX-3,MIN+3}) extremes.insert(x);
+	print(os,"extremes",extremes);
+	print_complement(os,extremes,MIN,MAX);
+	print_complement(os,extremes,MIN,MIN+1);
+	print_complement(os,extremes,MAX-2,MAX);
+	extremes.insert(MIN+2);
+	extremes.insert(MAX-2);
+	print(os,"extremes bridged",extremes);
+	print_complement(os,extremes,MIN,MAX);
+	if (argv==2)
+		os.flush_to_file(argc[1]);
+	else
+		os.flush_to_cout();
+	return 0;
+}
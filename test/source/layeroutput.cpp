@@ -0,0 +1,50 @@
+#include "layeroutput.h"
+#include "streamui.h"
+#include "output.h"
+
+using namespace std;
+
+const vector<Computation> batch{{1,vector<string>{"1","a"}},{1,vector<string>{"2","a"}},{1,vector<string>{"3","a"}},{2,vector<string>{"1","b"}}};
+
+//pass the lines to a parser as if they were printed by a work script running batch, and print what is stored and what is left to do
+void parse(OutputStream& os, UserInterface& ui, const CSVSchema& schema, const string& description, vector<string> lines) {
+	os<<description<<":"<<endl;
+	BatchOutput output{schema,vector<Computation>{batch},ui,[&os] (string&& line, const Computation& computation) {
+		os<<"stored "<<line<<" as "<<computation.to_string()<<endl;
+	}};
+	LayerOutputParser parser{output};
+	for (auto& line : lines) parser.add_line(std::move(line));
+	vector<string> not_completed;
+	for (auto& computation : output.not_completed()) not_completed.push_back(computation.to_string());
+	sort(not_completed.begin(),not_completed.end());
+	os<<"not completed:";
+	for (auto& computation : not_completed) os<<" "<<computation;
+	auto culprit=output.culprit();
+	os<<endl<<"culprit: "<<(culprit? culprit->to_string() : "none")<<endl;
+	if (parser.memory_error()) os<<"memory error"<<endl;
+}
+
+int main(int argv, char** argc) {
+	OutputStream os;
+	pt::ptree tree;
+	pt::read_info(argc[1],tree);
+	CSVSchema schema{tree};
+	StreamUserInterface ui{os.stream()};
+	parse(os,ui,schema,"lines",{"LINE 1;1;a;4;5;6;7;8","LINE 1;2;a;4;5;6;7;8"});
+	parse(os,ui,schema,"parts",{"PART 1;3;a;4;","PART 5;6;7;8","OVER","LINE 2;1;b;4;5;6;7;8"});
+	parse(os,ui,schema,"output not in the batch",{"LINE 1;4;a;4;5;6;7;8","LINE 1;1;a;4;5;6;7;8","LINE 1;1;a;4;5;6;7;8"});
+	parse(os,ui,schema,"end of output",{"LINE 1;1;a;4;5;6;7;8","","LINE 1;2;a;4;5;6;7;8"});
+	parse(os,ui,schema,"records",{"FRAME 15","1;1;a;4;5;6;7;8","FRAME 17","1;2;a;4;5;6\nx;7;8","LINE 1;3;a;4;5;6;7;8"});
+	parse(os,ui,schema,"truncated record",{"FRAME 15","1;1;a;4;5;6;7;8","FRAME 40","1;2;a;4;5;6"});
+	parse(os,ui,schema,"invalid record length",{"FRAME x","LINE 1;1;a;4;5;6;7;8"});
+	parse(os,ui,schema,"memory error",{"LINE 1;1;a;4;5;6;7;8","System error: Out of memory."});
+	parse(os,ui,schema,"dispatch ids",{"NEXT 0","LINE 1;1;a;4;5;6;7;8","NEXT 12","LINE 1;3;a;4;5;6;7;8","NEXT 18"});
+	parse(os,ui,schema,"output of another computation",{"NEXT 0","LINE 1;3;a;4;5;6;7;8"});
+	parse(os,ui,schema,"invalid dispatch ids",{"NEXT 6","NEXT 7","NEXT x","LINE 1;1;a;4;5;6;7;8"});
+	parse(os,ui,schema,"started computations",{"START 1;1;a","LINE 1;1;a;4;5;6;7;8","START 2;1;b"});
+	if (argv==3)
+		os.flush_to_file(argc[2]);
+	else
+		os.flush_to_cout();
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include "processreactor.h"
+#include "output.h"
+#include <boost/process.hpp>
+#include <algorithm>
+
+using namespace std;
+
+constexpr int CHILDREN=50;
+
+//a child process with the pipe its output is read from
+struct Child {
+	boost::process::async_pipe output;
+	boost::asio::streambuf buffer;
+	boost::process::child child;
+	template<typename... Args> Child(ProcessReactor& reactor, Args&&... args) : output{reactor.io_context()},
+		child{std::forward<Args>(args)..., boost::process::std_in.close(), boost::process::std_out > output} {}
+};
+
+int main(int argv, char** argc) {
+	OutputStream os;
+	ProcessReactor reactor;
+	mutex mtx;
+	condition_variable cv;
+	int lines=0, closed=0, stopped=0, exited=0, exit_status_zero=0;
+	//each handler is given the child, so that it is not destroyed while the reactor uses its pipe
+	auto on_exit=[&] (shared_ptr<Child> child) {
+		return [&,child] (bool terminated) {
+			ProcessUsage usage;
+			bool reaped=terminated && reap_child(child->child.id(),usage);
+			if (reaped) child->child.detach();
+			unique_lock<mutex> lock{mtx};
+			if (reaped) ++exited;
+			if (usage.exit_status==0) ++exit_status_zero;
+			cv.notify_all();
+		};
+	};
+	//the lines of all children are read by the reactor thread, while this thread only waits for all of them to exit
+	vector<shared_ptr<Child>> children;
+	for (int i=0;i<CHILDREN;++i) children.push_back(make_shared<Child>(reactor,"/bin/echo",to_string(i)));
+	//reading stops after the first line for even children, and goes on until the pipe is closed for odd children
+	for (int i=0;i<CHILDREN;++i) {
+		auto& child=children[i];
+		reactor.read_lines(child->output,child->buffer,[&,i] (string&&) {
+			unique_lock<mutex> lock{mtx};
+			++lines;
+			return i%2==1;
+		},{},[&,child] (bool stopped_reading) {
+			{
+				unique_lock<mutex> lock{mtx};
+				if (stopped_reading) ++stopped; else ++closed;
+			}
+			reactor.wait_for_exit(child->child.id(),on_exit(child));
+		});
+	}
+	children.clear();
+	{
+		unique_lock<mutex> lock{mtx};
+		cv.wait_for(lock,std::chrono::seconds(30),[&] () {return exited==CHILDREN;});
+		os<<"children: "<<CHILDREN<<", lines read: "<<lines<<", pipes closed: "<<closed<<", reading stopped: "<<stopped<<", reaped: "<<exited<<", exit status 0: "<<exit_status_zero<<endl;
+	}
+	//a record of a given length may contain newlines, and a last line not terminated by a newline is passed on when the pipe is closed
+	vector<string> items;
+	bool done=false, stopped_reading=true;
+	auto child=make_shared<Child>(reactor,"/usr/bin/printf","ab\\ncd\\nlast");
+	reactor.read_lines(child->output,child->buffer,[&] (string&& line) {
+		unique_lock<mutex> lock{mtx};
+		items.push_back(std::move(line));
+		return true;
+	},[&] () -> optional<std::size_t> {
+		unique_lock<mutex> lock{mtx};
+		if (items.empty()) return 5;
+		return nullopt;
+	},[&,child] (bool stopped) {
+		reactor.wait_for_exit(child->child.id(),[&,child] (bool) {
+			ProcessUsage usage;
+			if (reap_child(child->child.id(),usage)) child->child.detach();
+			unique_lock<mutex> lock{mtx};
+			stopped_reading=stopped;
+			done=true;
+			cv.notify_all();
+		});
+	});
+	child.reset();
+	{
+		unique_lock<mutex> lock{mtx};
+		cv.wait_for(lock,std::chrono::seconds(30),[&] () {return done;});
+		for (auto& item : items) {
+			std::replace(item.begin(),item.end(),'\n','|');
+			os<<"item: "<<item<<endl;
+		}
+		os<<"reading stopped: "<<stopped_reading<<endl;
+	}
+	if (argv==2)
+		os.flush_to_file(argc[1]);
+	else
+		os.flush_to_cout();
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include "segment.h"
+#include "output.h"
+#include <sys/resource.h>
+#include <csignal>
+
+using namespace std;
+
+void print_footer(OutputStream& os, const string& filename) {
+	auto keys=read_segment_footer(filename);
+	if (!keys) os<<"no footer"<<endl;
+	else {
+		os<<keys->size()<<" keys:";
+		for (auto& key : keys.value()) os<<" "<<key;
+		os<<endl;
+	}
+}
+
+int main(int argv, char** argc) {
+	OutputStream os;
+	auto directory=fs::temp_directory_path()/fs::unique_path();
+	fs::create_directory(directory);
+	auto name=new_segment_name(directory,".work");
+	os<<fs::path{name}.filename().native()<<endl;
+	{
+		SegmentWriter segment{name};
+		segment.add("1;a;b;output","1;a;b");
+		segment.add("2;c;d;output","2;c;d");
+		segment.write(false);
+		print_footer(os,name);
+		segment.add("3;e;f;output","3;e;f");
+		segment.close(false);
+		os<<"size "<<segment.size()<<", file size "<<fs::file_size(name)<<endl;
+	}
+	print_footer(os,name);
+	os<<fs::path{new_segment_name(directory,".work")}.filename().native()<<endl;
+	ifstream s{name};
+	string line;
+	while (std::getline(s,line)) 
+		if (!is_segment_metadata(line)) os<<line<<endl;
+	auto failing=new_segment_name(directory,".work");
+	{
+		SegmentWriter segment{failing};
+		segment.add("4;g;h;output","4;g;h");
+		segment.write(false);
+		std::signal(SIGXFSZ,SIG_IGN);	//writes beyond the limit fail with EFBIG instead
+		rlimit limit;
+		getrlimit(RLIMIT_FSIZE,&limit);
+		auto original=limit;
+		limit.rlim_cur=segment.size()+5;
+		setrlimit(RLIMIT_FSIZE,&limit);
+		segment.add("5;i;j;output","5;i;j");
+		segment.add("6;k;l;output","6;k;l");
+		try {
+			segment.write(false);
+		}
+		catch (const Exception& e) {
+			os<<"write failed, size "<<segment.size()<<", file size "<<fs::file_size(failing)<<(segment.broken()? ", broken" : "")<<endl;
+		}
+		setrlimit(RLIMIT_FSIZE,&original);
+		segment.add("6;k;l;output","6;k;l");
+		segment.close(false);
+	}
+	print_footer(os,failing);
+	ifstream f{failing};
+	while (std::getline(f,line)) 
+		if (!is_segment_metadata(line)) os<<line<<endl;
+	fs::remove_all(directory);
+	if (argv==2) 
+		os.flush_to_file(argc[1]);
+	else
+		os.flush_to_cout();
+	return 0;
+}
@@ -0,0 +1,55 @@
+#include "timerservice.h"
+#include "output.h"
+
+using namespace std;
+
+int main(int argv, char** argc) {
+	OutputStream os;
+	mutex mtx;
+	vector<string> fired;
+	auto record=[&mtx,&fired] (const string& name) {
+		return [&mtx,&fired,name] () {
+			unique_lock<mutex> lock{mtx};
+			fired.push_back(name);
+		};
+	};
+	{
+		TimerService timers;
+		auto unit=std::chrono::milliseconds{100};
+		timers.schedule(3*unit,record("third"));
+		auto canceled=timers.schedule(2*unit,record("canceled"));
+		auto extended=timers.schedule(1*unit,record("extended"));
+		auto rescheduled=timers.schedule(1*unit,record("rescheduled"));
+		timers.schedule(2*unit,record("second"));
+		timers.schedule(0*unit,record("first"));
+		os<<"cancel pending timer: "<<timers.cancel(canceled)<<endl;
+		os<<"extend pending timer: "<<timers.extend(extended,3*unit)<<endl;
+		os<<"reschedule pending timer: "<<timers.reschedule(rescheduled,5*unit)<<endl;
+		auto expired=timers.schedule(0*unit,[] () {});
+		std::this_thread::sleep_for(7*unit);
+		os<<"cancel expired timer: "<<timers.cancel(expired)<<endl;
+		os<<"extend expired timer: "<<timers.extend(expired,unit)<<endl;
+		os<<"reschedule expired timer: "<<timers.reschedule(expired,unit)<<endl;
+		timers.schedule(1000*unit,record("never"));
+	}
+	for (auto& name: fired) os<<name<<endl;
+	fired.clear();
+	{
+		TimerService timers;
+		auto unit=std::chrono::milliseconds{50};
+		vector<TimerService::TimerId> ids;
+		for (int i=0;i<8;++i) ids.push_back(timers.schedule(100*unit,record("timer "+std::to_string(i))));
+		for (int round=0;round<100000;++round) timers.reschedule(ids[round%8],(50+round%37)*unit);
+		for (int i=0;i<8;++i) timers.reschedule(ids[i],(8-i)*unit);
+		timers.extend(ids[7],10*unit);
+		timers.cancel(ids[3]);
+		std::this_thread::sleep_for(20*unit);
+	}
+	os<<"after rescheduling each timer many times:"<<endl;
+	for (auto& name: fired) os<<name<<endl;
+	if (argv==2) 
+		os.flush_to_file(argc[1]);
+	else
+		os.flush_to_cout();
+	return 0;
+}
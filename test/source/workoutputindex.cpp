@@ -0,0 +1,76 @@
+#include "workoutputindex.h"
+#include "output.h"
+#include <boost/property_tree/info_parser.hpp>
+
+namespace pt = boost::property_tree;
+
+using namespace std;
+
+const vector<Computation> candidates{{1,vector<string>{"1","1"}},{1,vector<string>{"1","2"}},{1,vector<string>{"1","3"}},{2,vector<string>{"1","1"}},{2,vector<string>{"1","2"}},{3,vector<string>{"5","a"}}};
+
+void append(const fs::path& path, const string& text) {
+	ofstream s{path.native(),std::ofstream::app};
+	s<<text;
+}
+
+int lines_in(const string& filename) {
+	ifstream s{filename};
+	string line;
+	int lines=0;
+	while (std::getline(s,line)) ++lines;
+	return lines;
+}
+
+//load a new index, as at the start of a run, and print the candidates it lists as completed
+void load_and_print(OutputStream& os, const string& description, const fs::path& directory, const string& index_file, const CSVSchema& schema) {
+	WorkOutputIndex index{directory.native(),index_file,schema};
+	CompletedComputations completed;
+	index.load(completed);
+	ComputationSet not_completed;
+	not_completed.insert(candidates.begin(),candidates.end());
+	completed.eliminate_computations(not_completed);
+	os<<description<<": "<<completed.size()<<" completed:";
+	for (auto& computation : candidates)
+		if (!not_completed.count(computation)) os<<" "<<computation.to_string();
+	os<<endl;
+}
+
+int main(int argv, char** argc) {
+	OutputStream os;
+	pt::ptree tree;
+	pt::read_info(argc[1],tree);
+	CSVSchema schema{tree};
+	auto directory=fs::temp_directory_path()/fs::unique_path();
+	fs::create_directory(directory);
+	auto index_file=(directory.parent_path()/(directory.filename().native()+".index")).native();
+	append(directory/"1.work","1;1;1;4;5;6;7;8\n1;1;2;Odin;5;6;7;8\n");
+	load_and_print(os,"initial scan",directory,index_file,schema);
+	append(directory/"1.work","1;1;3;4;Odin;6;7;8\n2;1;");
+	load_and_print(os,"partial last line",directory,index_file,schema);
+	append(directory/"1.work","1;4;5;6;7;8\n");
+	append(directory/"2.work","3;5;a;4;5;6;7;8\n");
+	load_and_print(os,"appended lines",directory,index_file,schema);
+	fs::resize_file(directory/"1.work",18);
+	load_and_print(os,"truncated file",directory,index_file,schema);
+	fs::remove(directory/"2.work");
+	load_and_print(os,"removed file",directory,index_file,schema);
+	{
+		WorkOutputIndex index{directory.native(),index_file,schema};
+		CompletedComputations completed;
+		index.load(completed);
+		append(directory/"1.work","2;1;2;4;5;6;7;8\n");
+		for (int i=0;i<10;++i) index.record((directory/"1.work").native(),vector<Computation>{});
+		index.record((directory/"1.work").native(),vector<Computation>{{2,vector<string>{"1","2"}}});
+	}
+	os<<"journal lines before compaction: "<<lines_in(index_file)<<endl;
+	load_and_print(os,"recorded lines",directory,index_file,schema);
+	os<<"journal lines after compaction: "<<lines_in(index_file)<<endl;
+	load_and_print(os,"compacted journal",directory,index_file,schema);
+	fs::remove_all(directory);
+	fs::remove(index_file);
+	if (argv==3)
+		os.flush_to_file(argc[2]);
+	else
+		os.flush_to_cout();
+	return 0;
+}